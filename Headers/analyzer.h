@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "chip8.h"
+
+// per-byte flags of an analysed memory image
+const uint8_t BYTE_INSTRUCTION = 0x1;   // an instruction starts here
+const uint8_t BYTE_CODE = 0x2;          // part of an instruction
+const uint8_t BYTE_DATA = 0x4;          // read as data (sprite, Fx33/Fx55/Fx65 with a known I)
+const uint8_t BYTE_LEADER = 0x8;        // first instruction of a basic block
+
+struct BasicBlock {
+    uint16_t start;
+    uint16_t end;                       // one past the last instruction
+    std::vector<uint16_t> successors;   // fall through and branch targets
+    uint16_t call;                      // 2nnn target when the block ends in a call, 0 otherwise
+    bool indirect;                      // ends in Bnnn, successors are the resolved jump table
+    bool returns;                       // ends in 00EE
+};
+
+// result of a recursive disassembly of a ROM from START_ADDRESS
+struct RomAnalysis {
+    uint8_t memory[4096]{};             // memory image the analysis ran on
+    uint8_t flags[4096]{};
+    uint16_t romEnd{};                  // one past the last ROM byte
+    std::vector<BasicBlock> blocks;     // sorted by start address
+    std::vector<uint16_t> subroutines;  // 2nnn targets, sorted
+
+    uint16_t Opcode(uint16_t address) const { return (memory[address & 0x0FFFu] << 8u) | memory[(address + 1) & 0x0FFFu]; }
+
+    // block starting at the address, or nullptr
+    const BasicBlock* BlockAt(uint16_t address) const;
+};
+
+// follows 1nnn/2nnn/skips and Bnnn jump tables, splits basic blocks and
+// marks sprite and Fx33/Fx55/Fx65 bytes reached through a known Annn as data;
+// an instruction is analysed with every I value (up to 8) that reaches it, a
+// jump table is the run of 1nnn/2nnn entries up to code reached some other
+// way, and bytes drawn or read by Fx65 are never code
+void AnalyzeRom(std::span<const uint8_t> rom, RomAnalysis& analysis);
+
+// listing of blocks with successors, then the data ranges
+void WriteAnalysisText(const RomAnalysis& analysis, std::ostream& out);
+
+// control-flow graph in Graphviz DOT, call edges dashed
+void WriteAnalysisDot(const RomAnalysis& analysis, std::ostream& out);
+
+// analyse a ROM file and print it as text or DOT
+int AnalyzeRomFile(const char* filename, bool dot, std::ostream& out);
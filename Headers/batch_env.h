@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+
+// observation layout written by BatchEnv, one block per instance
+enum class ObservationFormat {
+    Bits1,  // 1 bit per pixel, VIDEO_WIDTH * VIDEO_HEIGHT / 8 bytes
+    Bits8   // 1 byte per pixel (0 or 1), VIDEO_WIDTH * VIDEO_HEIGHT bytes
+};
+
+// reward term: weight * (change of the byte at address since the last step)
+struct RewardAddress {
+    uint16_t address;
+    float weight;
+};
+
+struct EnvConfig {
+    unsigned int frameSkip = 4;         // frames advanced per Step
+    unsigned int cyclesPerFrame = 10;   // Cycle() calls per frame
+    unsigned int bootFrames = 0;        // frames run before the reset snapshot is taken
+    unsigned int maxFrames = 0;         // episode length limit, 0 = none
+    ObservationFormat format = ObservationFormat::Bits8;
+    std::vector<RewardAddress> rewards;
+
+    // episode ends when (memory[doneAddress] & doneMask) == doneValue
+    bool useDoneAddress = false;
+    uint16_t doneAddress = 0;
+    uint8_t doneMask = 0xFF;
+    uint8_t doneValue = 0;
+};
+
+// runs many emulator instances of the same ROM in lockstep for agent training
+class BatchEnv {
+public:
+    BatchEnv(const char* romFilename, size_t numEnvs, const EnvConfig& config);
+
+    // result of loading the ROM; on failure every instance runs empty memory
+    LoadResult Status() const { return status; }
+
+    size_t Size() const { return envs.size(); }
+    size_t ObservationSize() const;
+
+    // reset every instance from the boot snapshot and write the first observations
+    void Reset(uint8_t* observations);
+
+    // actions: one 16-bit keypad mask per instance (bit n = key n held)
+    // observations: Size() * ObservationSize() bytes, written in place
+    // rewards, dones: one entry per instance; finished instances are reset automatically
+    void Step(const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones);
+
+private:
+    void ResetEnv(size_t env);
+    void WriteObservation(size_t env, uint8_t* observations) const;
+    bool IsDone(size_t env) const;
+
+    EnvConfig config;
+    LoadResult status;
+    std::vector<Chip8> envs;
+    std::vector<uint8_t> lastRewardValues;  // rewards.size() entries per instance
+    std::vector<unsigned int> frames;       // frames since the last reset
+    std::vector<unsigned int> episodes;     // resets so far, part of the instance's random seed
+    Chip8State bootState;
+};
+
+// step count instances of a ROM with the same actions (no key), with
+// episodes of half the steps, and check that the instances and each one's
+// two episodes saw different frames; 1 if any two did not
+int CheckBatchDiversity(const char* romFilename, size_t count, unsigned int steps);
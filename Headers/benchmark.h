@@ -0,0 +1,8 @@
+#pragma once
+
+// run the micro and ROM benchmarks, print them and write JSON to jsonFilename (if not null)
+// ROMs are read from romDirectory (test_opcode.ch8, Tetris.ch8)
+int RunBenchmarks(const char* jsonFilename, const char* romDirectory);
+
+// compare two benchmark JSON files, returns 1 if any benchmark got slower than thresholdPercent
+int CompareBenchmarks(const char* baselineFilename, const char* currentFilename, double thresholdPercent);
@@ -1,62 +1,255 @@
 #pragma once
 
+#include <bit>
 #include <cstdint>
 #include <cstring>
 #include <fstream>
-#include <random>
 #include <chrono>
+#include <span>
+
+#include "opcodes.h"
+#include "quirks.h"
 
 const unsigned int START_ADDRESS = 0x200;   // for interpreter reserves
 
 const unsigned int FONTSET_SIZE = 80;       // for displayed fonts
 const unsigned int FONTSET_START_ADDRESS = 0x50;
 
-const unsigned int VIDEO_WIDTH = 64;
+const unsigned int BIG_FONTSET_SIZE = 160;  // SCHIP 8x10 digits, Fx30
+const unsigned int BIG_FONTSET_START_ADDRESS = FONTSET_START_ADDRESS + FONTSET_SIZE;
+
+const unsigned int MEMORY_SIZE = 4096;       // classic and SCHIP
+const unsigned int XO_MEMORY_SIZE = 65536;  // XO-CHIP
+
+const unsigned int MAX_ROM_SIZE = MEMORY_SIZE - START_ADDRESS;
+const unsigned int XO_MAX_ROM_SIZE = XO_MEMORY_SIZE - START_ADDRESS;
+
+const unsigned int VIDEO_WIDTH = 64;        // classic display
 const unsigned int VIDEO_HEIGHT = 32;
+const unsigned int HIRES_WIDTH = 128;       // SCHIP high resolution, 00FF
+const unsigned int HIRES_HEIGHT = 64;
+
+// the display is one bit per pixel, each row VIDEO_ROW_WORDS words with the
+// leftmost pixel in the MSB of the first; low resolution uses the first
+// word of the first VIDEO_HEIGHT rows
+const unsigned int VIDEO_ROW_WORDS = HIRES_WIDTH / 64;
+
+enum class LoadResult {
+    Ok,
+    FileNotFound,
+    TooLarge,       // does not fit between START_ADDRESS and the end of memory
+    ReadError
+};
 
-class Chip8 {
+const char* LoadResultMessage(LoadResult result);
+
+// default Cycle policy, does nothing
+// Begin gets the address and opcode of the instruction about to run, End follows its handler
+struct NullProfiler {
+    template <typename Machine>
+    void Begin(const Machine&, uint16_t, uint16_t) {}
+    template <typename Machine>
+    void End(const Machine&, uint16_t) {}
+};
+
+// display planes of a machine: XO-CHIP has two, everything smaller one
+constexpr unsigned int PlaneCount(unsigned int memorySize) { return memorySize > MEMORY_SIZE ? 2 : 1; }
+
+// plain copy of the machine state, used for snapshots and fast resets
+template <unsigned int MemorySize>
+struct BasicChip8State {
+    uint8_t registers[16];
+    uint8_t memory[MemorySize];
+    uint64_t memoryHash;
+    uint16_t index;
+    uint16_t pc;
+    uint16_t stack[16];
+    uint8_t sp;
+    uint8_t delayTimer;
+    uint8_t soundTimer;
+    uint16_t keypad;
+    uint64_t video[PlaneCount(MemorySize)][HIRES_HEIGHT][VIDEO_ROW_WORDS];
+    uint64_t planeHash[PlaneCount(MemorySize)];
+    uint8_t rplFlags[16];
+    bool hires;
+    uint8_t planeMask;
+    uint8_t pitch;
+    uint8_t audioPattern[16];
+    uint32_t randState;
+};
+
+// The interpreter, sized by its memory. The memory size is the machine
+// variant: 4 KB runs CHIP-8 and SCHIP, 64 KB adds XO-CHIP (F000 nnnn,
+// 5xy2/5xy3, a second display plane selected by Fn01, the audio pattern
+// buffer). Everything the bigger machine needs is compiled out of the
+// classic one, so classic ROMs keep their 4 KB snapshots and dispatch.
+// Quirks is one of the policies in quirks.h; machines of one size share
+// their State whatever the quirks.
+template <unsigned int MemorySize, typename Quirks>
+class BasicChip8 {
 public:
-    Chip8();
+    static_assert(MemorySize == MEMORY_SIZE || MemorySize == XO_MEMORY_SIZE, "CHIP-8 or XO-CHIP memory");
+
+    static constexpr bool XO = MemorySize == XO_MEMORY_SIZE;
+    static constexpr unsigned int PLANES = PlaneCount(MemorySize);
+    static constexpr unsigned int MEMORY_MASK = MemorySize - 1;
+    static constexpr unsigned int MAX_ROM = MemorySize - START_ADDRESS;
+    static constexpr bool LOGIC_RESETS_VF = Quirks::logicResetsVF;
 
-    void LoadROM(const char* filename);
+    typedef BasicChip8State<MemorySize> State;
+
+    BasicChip8();
+
+    // both read straight into memory at START_ADDRESS
+    LoadResult LoadROM(const char* filename);
+    LoadResult LoadROM(std::span<const uint8_t> rom);
     void Cycle();
 
-    uint8_t keypad[16]{};		// stores values of keys pressed
-    uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};	// stores picture
+    // Cycle with a profiling policy wrapped around the executed handler (see profiler.h)
+    template <typename Profiler>
+    void Cycle(Profiler& profiler);
+
+    // snapshots
+    void SaveState(State& state) const;
+    void LoadState(const State& state);
+
+    // reseed the random number generator used by Cxkk; its state is part of
+    // the State, so a restored snapshot replays the same random bytes
+    void Seed(unsigned int seed);
+
+    // true while an Fx0A instruction is blocked waiting for a key
+    bool WaitingForKey() const { return waitingForKey; }
+
+    // waiting for a key with none held and both timers stopped: every further
+    // Cycle re-executes the same Fx0A and changes nothing, so the host can
+    // sleep until the keypad changes
+    bool Idle() const { return waitingForKey && !keypad && !delayTimer && !soundTimer; }
+
+    uint8_t ReadMemory(uint16_t address) const { return memory[address & MEMORY_MASK]; }
+    uint8_t Register(uint8_t reg) const { return registers[reg & 0xFu]; }
+    uint16_t Index() const { return index; }
+    uint16_t ProgramCounter() const { return pc; }
+    uint8_t StackPointer() const { return sp; }
+
+    // current display size, VIDEO_ or HIRES_WIDTH x HEIGHT
+    bool HighResolution() const { return hires; }
+    unsigned int VideoWidth() const { return hires ? HIRES_WIDTH : VIDEO_WIDTH; }
+    unsigned int VideoHeight() const { return hires ? HIRES_HEIGHT : VIDEO_HEIGHT; }
+
+    // first plane, and the planes of a pixel as bit n for plane n
+    bool Pixel(unsigned int x, unsigned int y) const { return (video[0][y][x / 64] >> (63 - x % 64)) & 1u; }
+    unsigned int PixelPlanes(unsigned int x, unsigned int y) const;
+
+    // XO-CHIP sound: 128 one-bit samples played at 4000 * 2^((pitch - 64) / 48) Hz while the sound timer runs
+    const uint8_t* AudioPattern() const { return audioPattern; }
+    uint8_t Pitch() const { return pitch; }
+
+    // write the display into a caller buffer at VIDEO_WIDTH x VIDEO_HEIGHT, 1 bit
+    // per pixel (MSB first) or 1 byte per pixel; a high resolution display
+    // is reduced by OR-ing each 2x2 block
+    void PackVideo1bpp(uint8_t* out) const;
+    void PackVideo8bpp(uint8_t* out) const;
+
+    // HIRES_WIDTH x HIRES_HEIGHT 32-bit pixels for a texture, all bits set where
+    // a pixel is on (grey levels for the XO-CHIP plane combinations); low
+    // resolution pixels are doubled
+    void ExpandVideo(uint32_t* out) const;
+
+    // 64-bit Zobrist hash of the display, every plane and the resolution;
+    // kept up to date by the instructions that change pixels, so reading it
+    // costs nothing. Equal frames have equal hashes across machines and runs.
+    uint64_t FrameHash() const;
+
+    // 64-bit hash of everything that decides how the machine goes on:
+    // registers, I, PC, SP, stack, timers, memory, display and resolution,
+    // SCHIP flags, XO-CHIP plane mask and the random number generator. Not
+    // the keypad, which is input, nor the XO-CHIP audio, which the program
+    // cannot read back. Memory and display keep their hashes up to date on
+    // every write and the remaining 80 bytes are mixed on each call, so it
+    // is cheap enough to key a transposition table; a snapshot restores it.
+    uint64_t StateHash() const;
+
+    // recompute the memory and display hashes of a State written by hand;
+    // LoadState takes a State's hashes as they are
+    static void Rehash(State& state);
+
+    uint16_t keypad{};			// bit n set while key n is held
+    uint64_t video[PLANES][HIRES_HEIGHT][VIDEO_ROW_WORDS]{};	// stores picture, see VIDEO_ROW_WORDS
 
 private:
+    friend class NativeContext;     // recompiled ROMs run directly on the machine state
+
     // in bytes
     uint8_t registers[16]{};	// CPU registers (16 8-bit registers)
-    uint8_t memory[4096]{};		// memory (stores interpreter reserves, ROM instructions, free space)
+    uint8_t memory[MemorySize]{};	// memory (stores interpreter reserves, ROM instructions, free space)
+    uint64_t memoryHash{};		// hash of memory, see StateHash; writes go through Store
     uint16_t index{};			// memory index register
     uint16_t pc{};				// program counter
-    uint16_t stack[16]{};		// stack of return locations in memory
+    uint16_t stack[16]{};		// stack of return locations in memory, indexed by sp modulo 16
     uint8_t sp{};				// stack pointer
     uint8_t delayTimer{};		//
     uint8_t soundTimer{};		//
     uint16_t opcode;			// current instruction
+    bool waitingForKey{};		// set by Fx0A until a key is pressed
+    bool hires{};				// SCHIP 128x64 mode
+    uint8_t rplFlags[16]{};		// SCHIP user flags, Fx75/Fx85
+    uint8_t planeMask{ 1 };		// XO-CHIP planes drawn, cleared and scrolled, Fn01
+    uint8_t pitch{ 64 };		// XO-CHIP audio pitch, Fx3A
+    uint8_t audioPattern[16]{};	// XO-CHIP audio samples, F002
+    uint64_t planeHash[PLANES]{};	// Zobrist hash of each plane's lit pixels, see FrameHash
+
+    typedef void (BasicChip8::* Chip8Func)();  // declares type alias for a pointer to a member function
+
+    // function pointer tables; the same for every instance of a machine, so
+    // one constant set per instantiation rather than copies in each object
+    struct Dispatch {
+        Chip8Func table[0xF + 1]{};
+        Chip8Func table0[0xFF + 1]{};
+        Chip8Func table5[0xF + 1]{};     // XO-CHIP only, classic 5xyn is always 5xy0
+        Chip8Func table8[0xF + 1]{};
+        Chip8Func tableE[0xF + 1]{};
+        Chip8Func tableF[0xFF + 1]{};
+    };
+
+    // member function running a handler of opcodes.h
+    static constexpr Chip8Func HandlerFunction(OpcodeHandler handler);
+
+    // every entry is the handler DecodeHandler gives the opcodes it covers
+    static constexpr Dispatch MakeDispatch();
+    static const Dispatch dispatch;
+
+    // skip the next instruction, all four bytes of an XO-CHIP F000 nnnn
+    void SkipNext();
 
-    typedef void (Chip8::* Chip8Func)();  // declares type alias for a pointer to a member function
-    Chip8Func table[0xF + 1];
-    Chip8Func table0[0xE + 1];
-    Chip8Func table8[0xE + 1];
-    Chip8Func tableE[0xE + 1];
-    Chip8Func tableF[0x65 + 1];
+    // write a byte of memory, wrapped to its size, keeping memoryHash
+    void Store(unsigned int address, uint8_t value);
 
+    // XOR a sprite 8 or 16 pixels wide into one plane, true on collision
+    template <unsigned int SpriteWidth>
+    bool DrawPlane(unsigned int plane, uint16_t address, unsigned int xPos, unsigned int yPos, unsigned int rows);
 
     void Table0();
+    void Table5();
     void Table8();
     void TableE();
     void TableF();
     void OP_NULL();
 
+    void OP_00Cn();
     void OP_00E0();
     void OP_00EE();
+    void OP_00FB();
+    void OP_00FC();
+    void OP_00FD();
+    void OP_00FE();
+    void OP_00FF();
     void OP_1nnn();
     void OP_2nnn();
     void OP_3xkk();
     void OP_4xkk();
     void OP_5xy0();
+    void OP_5xy2();
+    void OP_5xy3();
     void OP_6xkk();
     void OP_7xkk();
     void OP_8xy0();
@@ -75,17 +268,80 @@ private:
     void OP_Dxyn();
     void OP_Ex9E();
     void OP_ExA1();
+    void OP_F000();
+    void OP_Fn01();
+    void OP_F002();
     void OP_Fx07();
     void OP_Fx0A();
     void OP_Fx15();
     void OP_Fx18();
     void OP_Fx1E();
     void OP_Fx29();
+    void OP_Fx30();
     void OP_Fx33();
+    void OP_Fx3A();
     void OP_Fx55();
     void OP_Fx65();
+    void OP_Fx75();
+    void OP_Fx85();
+
+    // random number generator (xorshift32, never zero)
+    uint32_t randState{ 1 };
+    uint8_t RandomByte();
+};
+
+typedef BasicChip8<MEMORY_SIZE, DefaultQuirks> Chip8;
+typedef BasicChip8<MEMORY_SIZE, VipQuirks> VipChip8;
+typedef BasicChip8<MEMORY_SIZE, SchipQuirks> SchipChip8;
+typedef BasicChip8State<MEMORY_SIZE> Chip8State;
+
+typedef BasicChip8<XO_MEMORY_SIZE, XoChipQuirks> XoChip8;
+typedef BasicChip8State<XO_MEMORY_SIZE> XoChip8State;
+
+extern template class BasicChip8<MEMORY_SIZE, DefaultQuirks>;
+extern template class BasicChip8<MEMORY_SIZE, VipQuirks>;
+extern template class BasicChip8<MEMORY_SIZE, SchipQuirks>;
+extern template class BasicChip8<XO_MEMORY_SIZE, XoChipQuirks>;
+
+// the runtime selector: calls visitor.template operator()<Machine>() with
+// the machine compiled for a profile, e.g. a generic lambda
+//
+//     VisitQuirkProfile(profile, [&]<typename Machine>() { return Run<Machine>(rom); });
+template <typename Visitor>
+decltype(auto) VisitQuirkProfile(QuirkProfile profile, Visitor&& visitor) {
+    switch (profile) {
+        case QuirkProfile::Vip: return visitor.template operator()<VipChip8>();
+        case QuirkProfile::Schip: return visitor.template operator()<SchipChip8>();
+        case QuirkProfile::XoChip: return visitor.template operator()<XoChip8>();
+        default: return visitor.template operator()<Chip8>();
+    }
+}
+
+
+// Fetch, Decode, Execute Cylce
+template <unsigned int MemorySize, typename Quirks>
+template <typename Profiler>
+void BasicChip8<MemorySize, Quirks>::Cycle(Profiler& profiler) {
+    // fetch
+    opcode = (memory[pc & MEMORY_MASK] << 8u) | memory[(pc + 1) & MEMORY_MASK];
+
+    // increment PC
+    pc += 2;
+
+    // decode and execute
+    profiler.Begin(*this, pc - 2, opcode);
+    ((*this).*(dispatch.table[(opcode & 0xF000u) >> 12u]))();  // basically Chip8.function()
+    profiler.End(*this, opcode);
+
+    // decrement the delay timer if it is set
+    if (delayTimer > 0)
+    {
+        --delayTimer;
+    }
 
-    // random number generator
-    std::default_random_engine randGen;
-    std::uniform_int_distribution<uint16_t> randByte;
-};
\ No newline at end of file
+    // decrement the sound timer if it is set
+    if (soundTimer > 0)
+    {
+        --soundTimer;
+    }
+}
\ No newline at end of file
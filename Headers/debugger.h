@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include "chip8.h"
+
+// why Debugger::Run returned
+enum class StopReason {
+    Step,               // ran the requested number of instructions
+    Frame,              // ran the requested number of frames
+    Breakpoint,         // about to execute a breakpoint address
+    Watchpoint,         // the last instruction changed a watched address or register
+    WaitingForKey,      // blocked in Fx0A
+    Limit               // cycle limit reached, or the start of the recorded history
+};
+
+const char* StopReasonName(StopReason reason);
+
+// PC breakpoints plus memory and register watchpoints. Run picks the
+// cheapest engine that honours what is set: with nothing set it is a plain
+// Cycle() loop, breakpoints only add a flag lookup per instruction, and
+// only watchpoints run Cycle with the Debugger as its policy.
+//
+//     Debugger debugger;
+//     debugger.SetBreakpoint(0x2A0, true);
+//     debugger.Run(chip8, 1000000);
+class Debugger {
+public:
+    void SetBreakpoint(uint16_t address, bool enabled);
+    void SetMemoryWatch(uint16_t address, bool enabled);
+    void SetRegisterWatch(uint8_t reg, bool enabled);
+    void ClearAll();
+
+    bool Breakpoint(uint16_t address) const { return breakpoints[address & 0x0FFFu]; }
+    bool MemoryWatch(uint16_t address) const { return memoryWatches[address & 0x0FFFu]; }
+    bool RegisterWatch(uint8_t reg) const { return registerWatchMask & (1u << (reg & 0xFu)); }
+
+    // run up to cycles instructions; when resuming, a breakpoint at the
+    // current PC is stepped over so a stopped program can continue
+    StopReason Run(Chip8& chip8, uint64_t cycles, bool resume = true);
+
+    // run whole frames of cyclesPerFrame instructions, stopping early on a breakpoint or watchpoint
+    StopReason RunFrames(Chip8& chip8, uint64_t frames, unsigned int cyclesPerFrame);
+
+    // the change that stopped the last Run at a watchpoint
+    uint16_t HitAddress() const { return hitAddress; }
+    bool HitRegister() const { return hitRegister; }
+    uint8_t HitOld() const { return hitOld; }
+    uint8_t HitNew() const { return hitNew; }
+
+    uint64_t Executed() const { return executed; }
+
+    // Cycle policy hooks for the watchpoint engine
+    void Begin(const Chip8& chip8, uint16_t address, uint16_t opcode);
+    void End(const Chip8& chip8, uint16_t opcode);
+
+private:
+    template <bool CheckBreakpoints, bool CheckWatches>
+    StopReason Execute(Chip8& chip8, uint64_t cycles, bool resume);
+
+    bool breakpoints[4096]{};
+    bool memoryWatches[4096]{};
+    unsigned int breakpointCount{};
+    unsigned int memoryWatchCount{};
+    uint16_t registerWatchMask{};
+
+    // values before the current instruction, only for what it can write
+    uint8_t registersBefore[16]{};
+    uint8_t memoryBefore[16]{};
+    uint16_t indexBefore{};
+
+    bool hit{};
+    bool hitRegister{};
+    uint16_t hitAddress{};
+    uint8_t hitOld{};
+    uint8_t hitNew{};
+
+    uint64_t executed{};
+};
+
+// line-based console on a ROM: breakpoints, watchpoints, stepping and
+// inspection, "help" lists the commands
+int RunDebugConsole(const char* romFilename, unsigned int cyclesPerFrame, std::istream& in, std::ostream& out);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// mnemonic for one instruction, e.g. "DRW V1, V2, 5"; unknown opcodes become
+// "DW 0x1234"; xo for the XO-CHIP machine's instruction set
+std::string Disassemble(uint16_t opcode, bool xo = false);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <vector>
+
+#include "chip8.h"
+
+// Differential fuzzing: random ROMs, RNG seeds and key schedules run on
+// Chip8::Cycle and on a second engine in lockstep, comparing state hashes
+// every few cycles. The second engine is one of
+//
+//   Reference   a plain switch interpreter over Chip8State, written from the
+//               instruction descriptions, drawing and scrolling pixel by pixel
+//   Batch       RunBatch with timestamped key events and Idle skipping
+//   Snapshot    a machine saved and restored into a fresh one at every check
+//
+// Build Sources/fuzzer.cpp with CHIP8_LIBFUZZER and -fsanitize=fuzzer (and
+// without main.cpp) for a libFuzzer target that traps on a mismatch.
+enum class FuzzEngine {
+    Reference,
+    Batch,
+    Snapshot,
+    Count
+};
+
+// "reference", "batch", "snapshot"
+const char* FuzzEngineName(FuzzEngine engine);
+bool ParseFuzzEngine(const char* text, FuzzEngine& engine);
+
+// keypad from cycle on
+struct FuzzKey {
+    uint32_t cycle;
+    uint16_t keypad;
+};
+
+struct FuzzCase {
+    std::vector<uint8_t> rom;
+    uint32_t seed{};
+    uint32_t cycles{};
+    std::vector<FuzzKey> keys;      // sorted by cycle
+};
+
+// where two engines first disagreed
+struct FuzzMismatch {
+    uint32_t cycle;                 // instructions run at the first check with different hashes
+    Chip8State expected;            // Chip8::Cycle
+    Chip8State actual;              // the other engine
+};
+
+// 64-bit FNV-1a style hash over every field of a state
+uint64_t HashState(const Chip8State& state);
+
+// the fields of two states that differ, one per line
+void PrintStateDifference(std::ostream& out, const Chip8State& expected, const Chip8State& actual);
+
+// ROM of words mostly drawn from the instruction set, jumps and calls
+// aimed inside the ROM, a few raw random words
+FuzzCase GenerateFuzzCase(std::mt19937_64& generator);
+
+// run both engines, true if they agree at every check; checkInterval 1
+// compares after each instruction
+bool RunFuzzCase(const FuzzCase& fuzzCase, FuzzEngine engine, uint32_t checkInterval, FuzzMismatch* mismatch = nullptr);
+
+// smallest case found that still fails: cycles cut at the first differing
+// instruction, key events dropped, ROM words replaced by 0000 and trimmed
+FuzzCase MinimizeFuzzCase(const FuzzCase& fuzzCase, FuzzEngine engine);
+
+// fuzz cases on threads, report throughput, minimize and save the first failure as fuzz_failure.ch8
+int RunFuzzer(FuzzEngine engine, uint64_t cases, unsigned int threads, uint64_t seed, uint32_t checkInterval);
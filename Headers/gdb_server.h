@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "chip8.h"
+#include "debugger.h"
+#include "timeline.h"
+
+// GDB remote serial protocol server on a local TCP port. Registers are
+// V0-VF, I, PC and SP (numbered 0-18), the address space is the 4 KB of
+// memory. Supports breakpoints (Z0/Z1), write watchpoints (Z2), step,
+// continue, reverse step and continue (bs/bc, through a Timeline started
+// when the client attaches), interrupt and the target description XML.
+//
+// The socket is non-blocking and only touched from Poll, so the render loop
+// never waits on the client. While nothing is attached Run is the caller's
+// own Cycle loop:
+//
+//     server.Poll(chip8);
+//     if (!server.Attached()) chip8.Cycle();
+//     else if (!server.Halted()) server.Run(chip8, cyclesPerFrame);
+class GdbServer {
+public:
+    GdbServer() = default;
+    ~GdbServer();
+
+    GdbServer(const GdbServer&) = delete;
+    GdbServer& operator=(const GdbServer&) = delete;
+
+    // listen on 127.0.0.1:port
+    bool Listen(uint16_t port);
+    void Close();
+
+    // accept a client and handle whatever packets have arrived, never blocks
+    void Poll(Chip8& chip8);
+
+    // run cycles instructions for an attached client, reporting breakpoints and watchpoints to it
+    void Run(Chip8& chip8, uint64_t cycles);
+
+    bool Listening() const { return listener != INVALID; }
+    bool Attached() const { return client != INVALID; }
+    bool Halted() const { return halted; }
+
+    // the client sent a kill request
+    bool Killed() const { return killed; }
+
+private:
+    static const intptr_t INVALID = -1;
+
+    void Accept();
+    void Detach();
+    void Receive(Chip8& chip8);
+    void Process(Chip8& chip8);
+    void Handle(Chip8& chip8, const std::string& packet);
+    void Send(const std::string& payload);
+    void Stop(StopReason reason);
+
+    std::string ReadRegisters(const Chip8& chip8) const;
+    std::string ReadMemory(const Chip8& chip8, const std::string& args) const;
+    bool WriteMemory(Chip8& chip8, const std::string& args);
+    bool WriteRegister(Chip8& chip8, unsigned int reg, const std::string& value);
+    std::string Breakpoint(const std::string& args, bool insert);
+
+    intptr_t listener{ INVALID };
+    intptr_t client{ INVALID };
+    std::string input;
+    Debugger debugger;
+    Timeline timeline;
+
+    bool halted{};
+    bool resuming{};    // continue from a breakpoint: step over the one at PC
+    bool noAck{};
+    bool killed{};
+};
+
+// run a ROM headless at 60 frames per second and serve a debugger on port
+// until the client kills it
+int RunGdbServer(const char* romFilename, uint16_t port, unsigned int cyclesPerFrame);
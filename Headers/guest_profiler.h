@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "chip8.h"
+
+// Cycle policy recording where a ROM spends its instructions: a count per
+// guest address, and a call tree built from 2nnn/00EE. Per instruction it
+// only bumps two counters; calls and returns walk the tree and charge the
+// instructions since the last one to the node they leave. Sized by the
+// memory of the machine it profiles, like BasicChip8.
+//
+//     GuestProfiler profiler;
+//     chip8.Cycle(profiler);
+//     profiler.WriteFolded(file);
+template <unsigned int MemorySize>
+class BasicGuestProfiler {
+public:
+    BasicGuestProfiler();
+
+    template <typename Machine>
+    void Begin(const Machine&, uint16_t address, uint16_t) {
+        static_assert(Machine::MEMORY_MASK + 1 == MemorySize, "profiler sized for another machine");
+        ++addressCounts[address & (MemorySize - 1)];
+        ++executed;
+    }
+
+    template <typename Machine>
+    void End(const Machine&, uint16_t opcode) {
+        if ((opcode & 0xF000u) == 0x2000u) {
+            Call(opcode & 0x0FFFu);
+        }
+        else if (opcode == 0x00EEu) {
+            Return();
+        }
+    }
+
+    std::vector<uint64_t> addressCounts;    // MemorySize entries
+
+    // most executed addresses
+    void PrintHotSpots(std::ostream& out, size_t count) const;
+
+    // inclusive and exclusive instruction counts per subroutine
+    void PrintSubroutines(std::ostream& out) const;
+
+    // one "caller;callee count" line per call path, the format flame graph tools read
+    void WriteFolded(std::ostream& out) const;
+
+private:
+    // one node per distinct call path
+    struct Node {
+        uint32_t parent;
+        uint16_t subroutine;
+        uint8_t depth;
+        uint64_t self;
+    };
+
+    void Call(uint16_t subroutine);
+    void Return();
+
+    // charge the instructions run in the current node since it was entered
+    void Settle() {
+        nodes[current].self += executed - settled;
+        settled = executed;
+    }
+
+    // a node's self count including what is not settled yet
+    uint64_t Self(size_t node) const { return nodes[node].self + (node == current ? executed - settled : 0); }
+
+    std::vector<Node> nodes;
+    std::unordered_map<uint64_t, uint32_t> children;    // (parent, subroutine) -> node
+    uint32_t current{};
+    uint32_t ignoredCalls{};    // calls below the tree's last level not returned from yet
+    uint64_t executed{};        // instructions seen
+    uint64_t settled{};         // of them, charged to a node
+};
+
+typedef BasicGuestProfiler<MEMORY_SIZE> GuestProfiler;
+typedef BasicGuestProfiler<XO_MEMORY_SIZE> XoGuestProfiler;
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "chip8.h"
+
+// keypad state from timestamp on (steady clock nanoseconds)
+struct KeyEvent {
+    uint64_t timestamp;
+    uint16_t keypad;
+};
+
+// steady clock nanoseconds, the time base of KeyEvent
+inline uint64_t InputTimestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// lock-free single producer/single consumer queue of key events from the
+// input thread to the emulation thread; a full ring drops the event
+class InputRing {
+public:
+    static const uint32_t CAPACITY = 256;
+
+    bool Push(const KeyEvent& event) {
+        uint32_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) >= CAPACITY) {
+            return false;
+        }
+        events[position & (CAPACITY - 1)] = event;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // oldest event without removing it
+    bool Peek(KeyEvent& event) const {
+        uint32_t position = tail.load(std::memory_order_relaxed);
+        if (position == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        event = events[position & (CAPACITY - 1)];
+        return true;
+    }
+
+    bool Empty() const {
+        return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire);
+    }
+
+    void Pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    KeyEvent events[CAPACITY]{};
+    alignas(64) std::atomic<uint32_t> head{};   // written by the producer
+    alignas(64) std::atomic<uint32_t> tail{};   // written by the consumer
+};
+
+// Run cycles instructions emulating the time from batchStart on, one
+// instruction every cycleNanoseconds. Each queued key event lands right
+// before the first instruction at or after its timestamp instead of at the
+// start of the batch. Events older than the batch (the input that arrived
+// while the previous batch was shown) are moved later as a group: the
+// oldest applies before the first instruction and the others keep their
+// spacing to it, so a tap shorter than a frame is still seen. Events that
+// fall past the batch stay queued for the next one. Cycles spent Idle up to
+// the next event are skipped, they would not change the machine.
+template <typename Machine, typename Profiler>
+void RunBatch(Machine& chip8, InputRing& input, uint64_t batchStart, uint64_t cycleNanoseconds, uint64_t cycles, Profiler& profiler) {
+    uint64_t cycle = 0;
+    KeyEvent event;
+
+    // how far late input is moved
+    uint64_t lag = 0;
+    if (input.Peek(event) && event.timestamp < batchStart) {
+        lag = batchStart - event.timestamp;
+    }
+
+    while (cycle < cycles) {
+        // instruction the next event applies before
+        uint64_t until = cycles;
+        if (input.Peek(event)) {
+            uint64_t timestamp = event.timestamp + lag;
+            uint64_t due = timestamp > batchStart ? (timestamp - batchStart + cycleNanoseconds - 1) / cycleNanoseconds : 0;
+            if (due <= cycle) {
+                chip8.keypad = event.keypad;
+                input.Pop();
+                continue;
+            }
+            if (due < until) {
+                until = due;
+            }
+        }
+
+        for (; cycle < until && !chip8.Idle(); ++cycle) {
+            chip8.Cycle(profiler);
+        }
+        if (chip8.Idle()) {
+            cycle = until;
+        }
+    }
+}
+
+// apply every queued event now, for callers that do not batch
+template <typename Machine>
+void DrainInput(Machine& chip8, InputRing& input) {
+    KeyEvent event;
+    while (input.Peek(event)) {
+        chip8.keypad = event.keypad;
+        input.Pop();
+    }
+}
+
+// compare delivering input at batch start, at its cycle in a batch that
+// emulates the frame that just ended, and at its cycle (late input moved to
+// the start) in a batch that emulates the frame ahead, as the frontend
+// does: latency from a key event to the first Ex9E/ExA1 that observes it on
+// a ROM that polls one key in a loop, and how many taps shorter than a
+// frame the ROM sees
+int MeasureInputLatency(unsigned int cyclesPerFrame, unsigned int frames);
+
+// CPU time of a ROM parked on Fx0A under the old spin-and-poll frontend loop
+// and under frame pacing that sleeps while the machine is Idle
+int MeasureIdleCpu(unsigned int cyclesPerFrame, unsigned int seconds);
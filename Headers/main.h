@@ -5,9 +5,35 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <fstream>
+#include <memory>
+#include <type_traits>
 
 #include "platform.h"
 #include "chip8.h"
+#include "session.h"
+#include "batch_env.h"
+#include "profiler.h"
+#include "guest_profiler.h"
+#include "tracer.h"
+#include "benchmark.h"
+#include "rom_store.h"
+#include "analyzer.h"
+#include "recompiler.h"
+#include "debugger.h"
+#include "gdb_server.h"
+#include "input.h"
+#include "fuzzer.h"
+#include "regression.h"
+#include "search.h"
+
+// define CHIP8_PROFILE to build the frontend with the opcode profiler,
+// CHIP8_PROFILE_TICKS=1 also times each handler, CHIP8_GUEST_PROFILE records
+// guest hot spots and call paths instead, CHIP8_TRACE writes chip8.trace;
+// CHIP8_GDB_PORT=<port> serves a GDB remote debugger on localhost
+#if defined(CHIP8_PROFILE) && !defined(CHIP8_PROFILE_TICKS)
+#define CHIP8_PROFILE_TICKS 0
+#endif
 
 // Function declarations (if additional modular functions are needed in the future)
 int main(int argc, char** argv);
\ No newline at end of file
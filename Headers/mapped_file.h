@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // map an existing file read-only
+    bool OpenRead(const char* filename);
+
+    // create the file if needed, set its size (keeping existing contents) and map it read-write
+    bool OpenWrite(const char* filename, size_t size);
+
+    void Close();
+
+    uint8_t* Data() const { return data; }
+    size_t Size() const { return size; }
+    bool IsOpen() const { return opened; }
+
+private:
+    bool Map(const char* filename, size_t size, bool writable);
+
+    uint8_t* data{};
+    size_t size{};
+    bool opened{};
+#ifdef _WIN32
+    void* file{};
+    void* mapping{};
+#else
+    int file{ -1 };
+#endif
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+
+// one entry per instruction handler of the core
+enum OpcodeHandler : uint8_t {
+    HANDLER_NULL,
+    HANDLER_00E0, HANDLER_00EE, HANDLER_1nnn, HANDLER_2nnn, HANDLER_3xkk, HANDLER_4xkk, HANDLER_5xy0,
+    HANDLER_6xkk, HANDLER_7xkk, HANDLER_8xy0, HANDLER_8xy1, HANDLER_8xy2, HANDLER_8xy3, HANDLER_8xy4,
+    HANDLER_8xy5, HANDLER_8xy6, HANDLER_8xy7, HANDLER_8xyE, HANDLER_9xy0, HANDLER_Annn, HANDLER_Bnnn,
+    HANDLER_Cxkk, HANDLER_Dxyn, HANDLER_Ex9E, HANDLER_ExA1, HANDLER_Fx07, HANDLER_Fx0A, HANDLER_Fx15,
+    HANDLER_Fx18, HANDLER_Fx1E, HANDLER_Fx29, HANDLER_Fx33, HANDLER_Fx55, HANDLER_Fx65,
+    // SCHIP
+    HANDLER_00Cn, HANDLER_00FB, HANDLER_00FC, HANDLER_00FD, HANDLER_00FE, HANDLER_00FF, HANDLER_Fx30,
+    HANDLER_Fx75, HANDLER_Fx85,
+    // XO-CHIP
+    HANDLER_5xy2, HANDLER_5xy3, HANDLER_F000, HANDLER_Fn01, HANDLER_F002, HANDLER_Fx3A,
+    HANDLER_COUNT
+};
+
+// handler run for an opcode, those of the XO-CHIP machine if xo. This is
+// the decoder: BasicChip8 builds its dispatch tables from it, so it only
+// looks at the bits they index (the group, then the low byte of 0 and F,
+// the low nibble of 5, 8 and E)
+constexpr OpcodeHandler DecodeHandler(uint16_t opcode, bool xo = false) {
+    switch (opcode >> 12u) {
+        case 0x0: {
+            if ((opcode & 0x00F0u) == 0x00C0u) {
+                return HANDLER_00Cn;
+            }
+            switch (opcode & 0x00FFu) {
+                case 0xE0: return HANDLER_00E0;
+                case 0xEE: return HANDLER_00EE;
+                case 0xFB: return HANDLER_00FB;
+                case 0xFC: return HANDLER_00FC;
+                case 0xFD: return HANDLER_00FD;
+                case 0xFE: return HANDLER_00FE;
+                case 0xFF: return HANDLER_00FF;
+            }
+        }break;
+
+        case 0x1: return HANDLER_1nnn;
+        case 0x2: return HANDLER_2nnn;
+        case 0x3: return HANDLER_3xkk;
+        case 0x4: return HANDLER_4xkk;
+        case 0x5: {
+            if (!xo) {
+                return HANDLER_5xy0;
+            }
+            switch (opcode & 0x000Fu) {
+                case 0x0: return HANDLER_5xy0;
+                case 0x2: return HANDLER_5xy2;
+                case 0x3: return HANDLER_5xy3;
+            }
+        }break;
+        case 0x6: return HANDLER_6xkk;
+        case 0x7: return HANDLER_7xkk;
+
+        case 0x8: {
+            switch (opcode & 0x000Fu) {
+                case 0x0: return HANDLER_8xy0;
+                case 0x1: return HANDLER_8xy1;
+                case 0x2: return HANDLER_8xy2;
+                case 0x3: return HANDLER_8xy3;
+                case 0x4: return HANDLER_8xy4;
+                case 0x5: return HANDLER_8xy5;
+                case 0x6: return HANDLER_8xy6;
+                case 0x7: return HANDLER_8xy7;
+                case 0xE: return HANDLER_8xyE;
+            }
+        }break;
+
+        case 0x9: return HANDLER_9xy0;
+        case 0xA: return HANDLER_Annn;
+        case 0xB: return HANDLER_Bnnn;
+        case 0xC: return HANDLER_Cxkk;
+        case 0xD: return HANDLER_Dxyn;
+
+        case 0xE: {
+            switch (opcode & 0x000Fu) {
+                case 0xE: return HANDLER_Ex9E;
+                case 0x1: return HANDLER_ExA1;
+            }
+        }break;
+
+        case 0xF: {
+            switch (opcode & 0x00FFu) {
+                case 0x07: return HANDLER_Fx07;
+                case 0x0A: return HANDLER_Fx0A;
+                case 0x15: return HANDLER_Fx15;
+                case 0x18: return HANDLER_Fx18;
+                case 0x1E: return HANDLER_Fx1E;
+                case 0x29: return HANDLER_Fx29;
+                case 0x30: return HANDLER_Fx30;
+                case 0x33: return HANDLER_Fx33;
+                case 0x55: return HANDLER_Fx55;
+                case 0x65: return HANDLER_Fx65;
+                case 0x75: return HANDLER_Fx75;
+                case 0x85: return HANDLER_Fx85;
+            }
+            if (xo) {
+                switch (opcode & 0x00FFu) {
+                    case 0x00: return HANDLER_F000;
+                    case 0x01: return HANDLER_Fn01;
+                    case 0x02: return HANDLER_F002;
+                    case 0x3A: return HANDLER_Fx3A;
+                }
+            }
+        }break;
+    }
+
+    return HANDLER_NULL;
+}
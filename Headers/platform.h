@@ -3,6 +3,33 @@
 #include <SDL.h>
 #include <cstdint>
 
+#include "input.h"
+#include "telemetry.h"
+
+// keymap entries: a keypad key 0x0-0xF, or one of these
+const int8_t KEYMAP_NONE = -1;
+const int8_t KEYMAP_QUIT = -2;
+const int8_t KEYMAP_OVERLAY = -3;
+
+// index of gamepad button b in the keymap; scancodes stop well below it
+const unsigned int KEYMAP_GAMEPAD_BASE = 400;
+const unsigned int KEYMAP_SIZE = SDL_NUM_SCANCODES;
+
+static_assert(KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_MAX <= KEYMAP_SIZE, "gamepad buttons must fit in the keymap");
+
+// scancode (or KEYMAP_GAMEPAD_BASE + button) -> keypad key or action
+struct KeyMap {
+    int8_t entries[KEYMAP_SIZE];
+
+    // the usual 1234/QWER/ASDF/ZXCV layout, Escape, F1 and a gamepad d-pad on 2/4/6/8
+    KeyMap();
+
+    // "<key> <target>" lines replace entries; key is an SDL scancode name
+    // ("X", "Left Shift") or pad:<button> ("pad:dpup"), target a hex keypad
+    // key, quit, overlay or none. Lines starting with # are comments.
+    bool Load(const char* filename);
+};
+
 class Platform {
 public:
     // Constructor
@@ -11,13 +38,31 @@ public:
     // Destructor
     ~Platform();
 
-    // Update the texture and render it
-    void Update(const void* buffer, int pitch);
+    // Update the texture and render it, timing the upload and present phases if telemetry is given
+    void Update(const void* buffer, int pitch, FrameTelemetry* telemetry = nullptr);
 
-    // Process input and update key states
-    bool ProcessInput(uint8_t* keys);
+    // Process input and update the keypad mask through the keymap, true on quit
+    bool ProcessInput(uint16_t& keys);
+
+    // Process input and queue each keypad change stamped with the time SDL saw it, true on quit
+    bool ProcessInput(InputRing& input);
+
+    // ProcessInput(input), first sleeping up to timeout ms (-1 for ever) until an event arrives
+    bool WaitInput(InputRing& input, int timeout);
+
+    KeyMap keyMap;
 
 private:
+    // drain the SDL queue into keys, pushing every change to input if given;
+    // a nonzero timeout waits that long for the first event
+    bool PollEvents(uint16_t& keys, InputRing* input, int timeout);
+
+    // recent frame times as stacked bars: emulate green, upload yellow, present red
+    void DrawOverlay(const FrameTelemetry& telemetry);
+
+    bool showOverlay = false;
+    uint16_t heldKeys = 0;
+
     SDL_Window* window;
     SDL_Renderer* renderer;
     SDL_Texture* texture;
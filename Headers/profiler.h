@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "chip8.h"
+#include "opcodes.h"
+
+// "OP_Dxyn" etc.
+const char* HandlerName(OpcodeHandler handler);
+
+// time stamp counter, or nanoseconds where there is none
+inline uint64_t ReadTimestamp() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// collected results, shared by every profiler instantiation
+class OpcodeProfile {
+public:
+    uint64_t counts[HANDLER_COUNT]{};
+    uint64_t ticks[HANDLER_COUNT]{};
+
+    // table sorted by execution count
+    void Print(std::ostream& out) const;
+    void WriteJson(std::ostream& out) const;
+    bool WriteJson(const char* filename) const;
+
+protected:
+    explicit OpcodeProfile(bool timed) : timed(timed) {}
+
+    bool timed;
+};
+
+// Cycle policy counting executions per handler, SampleTicks also adds up
+// time stamp counter ticks spent inside each handler
+//
+//     OpcodeProfiler<true> profiler;
+//     chip8.Cycle(profiler);
+template <bool SampleTicks>
+class OpcodeProfiler : public OpcodeProfile {
+public:
+    OpcodeProfiler() : OpcodeProfile(SampleTicks) {}
+
+    template <typename Machine>
+    void Begin(const Machine&, uint16_t, uint16_t opcode) {
+        current = DecodeHandler(opcode, Machine::XO);
+        ++counts[current];
+
+        if constexpr (SampleTicks) {
+            start = ReadTimestamp();
+        }
+    }
+
+    template <typename Machine>
+    void End(const Machine&, uint16_t) {
+        if constexpr (SampleTicks) {
+            ticks[current] += ReadTimestamp() - start;
+        }
+    }
+
+private:
+    OpcodeHandler current{};
+    uint64_t start{};
+};
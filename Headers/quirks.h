@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+// Behaviours that differ between CHIP-8 interpreters. BasicChip8 takes one
+// of these as a template policy, so every profile is its own engine with
+// the choices folded into the handlers instead of tested per instruction.
+//
+//   shiftVy           8xy6/8xyE shift Vy into Vx instead of shifting Vx in place
+//   loadStoreIndex    Fx55/Fx65 leave I pointing past the last register
+//   jumpVx            Bxnn jumps to xnn + Vx instead of nnn + V0
+//   logicResetsVF     8xy1/8xy2/8xy3 clear VF
+//   wrapSprites       sprites wrap around the display edges instead of clipping
+
+// this interpreter's behaviour before profiles existed
+struct DefaultQuirks {
+    static constexpr bool shiftVy = false;
+    static constexpr bool loadStoreIndex = false;
+    static constexpr bool jumpVx = false;
+    static constexpr bool logicResetsVF = false;
+    static constexpr bool wrapSprites = false;
+};
+
+// COSMAC VIP
+struct VipQuirks {
+    static constexpr bool shiftVy = true;
+    static constexpr bool loadStoreIndex = true;
+    static constexpr bool jumpVx = false;
+    static constexpr bool logicResetsVF = true;
+    static constexpr bool wrapSprites = false;
+};
+
+// SUPER-CHIP 1.1 on the HP 48
+struct SchipQuirks {
+    static constexpr bool shiftVy = false;
+    static constexpr bool loadStoreIndex = false;
+    static constexpr bool jumpVx = true;
+    static constexpr bool logicResetsVF = false;
+    static constexpr bool wrapSprites = false;
+};
+
+// XO-CHIP as Octo runs it
+struct XoChipQuirks {
+    static constexpr bool shiftVy = true;
+    static constexpr bool loadStoreIndex = true;
+    static constexpr bool jumpVx = false;
+    static constexpr bool logicResetsVF = false;
+    static constexpr bool wrapSprites = true;
+};
+
+// runtime name of a profile, the quirks id stored in the ROM store
+enum class QuirkProfile : uint32_t {
+    Default,
+    Vip,
+    Schip,
+    XoChip,
+    Count
+};
+
+// "default", "vip", "schip", "xochip"
+const char* QuirkProfileName(QuirkProfile profile);
+
+// a profile name or its numeric id, false if it is neither
+bool ParseQuirkProfile(const char* text, QuirkProfile& profile);
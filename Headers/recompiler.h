@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chip8.h"
+
+// direct access to a machine's state for recompiled code; memory writes,
+// display, keypad, random numbers and timers still go through the core
+class NativeContext {
+public:
+    explicit NativeContext(Chip8& chip8)
+        : chip8(chip8), V(chip8.registers), memory(chip8.memory), I(chip8.index), pc(chip8.pc),
+          stack(chip8.stack), sp(chip8.sp), keypad(chip8.keypad) {}
+
+    Chip8& chip8;
+    uint8_t* V;
+    uint8_t* memory;
+    uint16_t& I;
+    uint16_t& pc;
+    uint16_t* stack;
+    uint8_t& sp;
+    uint16_t& keypad;
+
+    uint64_t timerBase{};   // cycle count the timers are exact at
+    bool modified{};        // native code wrote over code bytes
+
+    void Clear() { chip8.OP_00E0(); }
+
+    // memory writes keep the machine's state hash
+    void Store(unsigned int address, uint8_t value) { chip8.Store(address, value); }
+
+    void Draw(uint16_t opcode) {
+        chip8.opcode = opcode;
+        chip8.OP_Dxyn();
+    }
+
+    // instructions without inline code (SCHIP display modes, scrolls, flags) run the core's handler
+    void Interpret(uint16_t opcode) {
+        chip8.opcode = opcode;
+        ((chip8).*(chip8.dispatch.table[(opcode & 0xF000u) >> 12u]))();
+    }
+
+    uint8_t Random() { return chip8.RandomByte(); }
+
+    // the interpreter decrements both timers once per instruction; recompiled
+    // code catches up lazily, before timer accesses and on exit
+    void SyncTimers(uint64_t executed) {
+        uint64_t elapsed = executed - timerBase;
+        chip8.delayTimer = chip8.delayTimer > elapsed ? static_cast<uint8_t>(chip8.delayTimer - elapsed) : 0;
+        chip8.soundTimer = chip8.soundTimer > elapsed ? static_cast<uint8_t>(chip8.soundTimer - elapsed) : 0;
+        timerBase = executed;
+    }
+
+    uint8_t& DelayTimer() { return chip8.delayTimer; }
+    uint8_t& SoundTimer() { return chip8.soundTimer; }
+};
+
+// runs at most budget instructions from ctx.pc, returns how many it ran;
+// returns early where it needs the interpreter (unknown target, Fx0A, modified code)
+typedef uint64_t (*NativeEntry)(NativeContext& ctx, uint64_t budget);
+
+// a ROM compiled by RecompileRom, registered by the generated translation unit
+struct NativeRom {
+    uint64_t hash;              // HashRom of the image
+    const char* name;
+    const uint8_t* image;       // ROM image the code was generated from
+    uint16_t size;
+    const uint8_t* codeMap;     // 4096 entries, 1 where a byte belongs to compiled code
+    NativeEntry entry;
+};
+
+bool RegisterNativeRom(const NativeRom& rom);
+const NativeRom* FindNativeRom(uint64_t hash);
+
+// executes a machine with the compiled code of its ROM, falling back to
+// Chip8::Cycle where the code cannot run; once code bytes are overwritten
+// it stays on the interpreter
+class NativeRunner {
+public:
+    NativeRunner(Chip8& chip8, const NativeRom& rom) : chip8(chip8), rom(rom), ctx(chip8) {}
+
+    // run exactly this many instructions
+    void Run(uint64_t cycles);
+
+    bool Disabled() const { return disabled; }
+
+private:
+    bool CodeIntact() const;
+
+    Chip8& chip8;
+    const NativeRom& rom;
+    NativeContext ctx;
+    bool disabled{};
+};
+
+// write a C++ translation unit with one label per basic block of the ROM;
+// the generated code has the DefaultQuirks behaviour of Chip8
+int RecompileRom(const char* romFilename, const char* outFilename, const char* name);
+
+// run a ROM on the interpreter and on its compiled code side by side,
+// compare frame hashes every frame and time both
+int CompareNative(const char* romFilename, unsigned int frames, unsigned int cyclesPerFrame);
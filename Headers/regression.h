@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "quirks.h"
+
+// keypad from frame on
+struct MovieInput {
+    uint32_t frame;
+    uint16_t keypad;
+};
+
+// expected FrameHash after frame frames
+struct GoldenFrame {
+    uint32_t frame;
+    uint64_t hash;
+};
+
+// one manifest line:
+//
+//     <rom> <seed> <movie or -> <quirks> <cyclesPerFrame> <frame>=<hash> ...
+//
+// paths relative to the manifest, quirks a QuirkProfile name or id, hashes
+// in hex; # starts a comment line
+struct RegressionEntry {
+    std::string rom;
+    uint32_t seed{};
+    std::string movie;                  // empty for no input
+    QuirkProfile quirks{};
+    unsigned int cyclesPerFrame{ 10 };
+    std::vector<GoldenFrame> frames;    // sorted by frame
+};
+
+// "<frame> <keypad hex>" lines, sorted on load
+bool LoadMovie(const char* filename, std::vector<MovieInput>& movie);
+
+bool LoadManifest(const char* filename, std::vector<RegressionEntry>& entries, std::ostream& errors);
+
+// run every entry of the manifest on threads (0 for one per core), report
+// each frame whose hash differs and dump it to dumpDirectory as
+// <rom>_<entry>_<frame>.png, entry counting manifest entries from 0; 1 if
+// anything failed
+int RunRegression(const char* manifestFilename, unsigned int threads, const char* dumpDirectory);
+
+// print the manifest with every listed frame's hash taken from this build
+int RecordRegression(const char* manifestFilename, std::ostream& out);
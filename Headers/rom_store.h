@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "chip8.h"
+#include "mapped_file.h"
+
+// one ROM in the store: its image, metadata and a snapshot taken after booting it
+struct RomStoreEntry {
+    uint64_t hash;              // HashRom of the image
+    char name[48];              // file name, truncated
+    uint16_t size;
+    uint16_t cyclesPerFrame;    // recommended instructions per frame
+    uint32_t quirks;            // QuirkProfile id
+    uint32_t bootFrames;        // frames run before the snapshot
+    uint32_t reserved;
+    uint8_t rom[MAX_ROM_SIZE];
+    Chip8State boot;
+};
+
+// start of an index file, followed by count entries sorted by hash
+struct RomStoreHeader {
+    char magic[4];              // "C8RS"
+    uint32_t entrySize;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+// 64-bit FNV-1a of a ROM image
+uint64_t HashRom(std::span<const uint8_t> rom);
+
+// build an index of every file in romDirectory
+// metadata.txt in the directory may override the defaults per ROM, one
+// "<file> <cyclesPerFrame> <quirks> <bootFrames>" line each, quirks a
+// QuirkProfile name or id; XO-CHIP ROMs are not stored, their snapshots
+// do not fit an entry
+int BuildRomStore(const char* romDirectory, const char* indexFilename, unsigned int cyclesPerFrame, unsigned int bootFrames);
+
+// read-only view of an index file shared by every worker of a host
+class RomStore {
+public:
+    bool Open(const char* indexFilename);
+
+    size_t Count() const { return count; }
+    const RomStoreEntry& Entry(size_t i) const { return entries[i]; }
+
+    const RomStoreEntry* Find(uint64_t hash) const;
+    const RomStoreEntry* FindByName(const char* name) const;
+
+    // put a machine into the entry's post-boot state, no file access or parsing;
+    // Machine is the 4 KB machine of the entry's quirks
+    template <typename Machine>
+    static void Start(const RomStoreEntry& entry, Machine& chip8) { chip8.LoadState(entry.boot); }
+
+private:
+    MappedFile file;
+    const RomStoreEntry* entries{};
+    size_t count{};
+};
+
+// quirk profile to run a ROM file with: its store entry if the store has
+// one, else .xo8 (or too large for 4 KB) is XO-CHIP, .sc8 SCHIP and
+// anything else the default
+QuirkProfile SelectQuirkProfile(const char* romFilename, const RomStore* store);
+
+// time starting instances from the ROM files (load and boot) against starting
+// them from the store, each on the machine of its entry's quirks
+int MeasureRomStartup(const char* indexFilename, const char* romDirectory, unsigned int instances);
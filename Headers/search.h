@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "quirks.h"
+
+// Input-space search: from a booted ROM, try every action (a keypad mask
+// held for framesPerStep frames) on every state of one depth, drop children
+// whose StateHash was seen before (the transposition table), score the rest
+// on memory bytes and keep the best width of them for the next depth, until
+// a state meets the goal or maxDepth is reached. Width 0 keeps every new
+// state, a breadth-first search bounded by maxNodes.
+//
+// Children are run in parallel and kept as a few bytes each; only the ones
+// that survive are run again to get their State, so a depth holds width
+// snapshots whatever the number of actions.
+
+// score term: weight * the byte at address
+struct ScoreAddress {
+    uint16_t address;
+    double weight;
+};
+
+// goal term: the byte at address equals value
+struct GoalAddress {
+    uint16_t address;
+    uint8_t value;
+};
+
+struct SearchConfig {
+    QuirkProfile quirks{};
+    uint32_t seed{};
+    unsigned int cyclesPerFrame{ 10 };
+    unsigned int bootFrames{ 0 };           // frames run without input before the search starts
+    unsigned int framesPerStep{ 4 };        // frames an action is held
+    unsigned int maxDepth{ 100 };           // steps
+    unsigned int width{ 256 };              // states kept per depth, 0 for all of them
+    uint64_t maxNodes{ 4000000 };           // states the search may keep in total
+    unsigned int threads{ 0 };              // 0 for one per core
+    std::vector<uint16_t> actions;          // keypad masks; empty for no key and each single key
+    std::vector<ScoreAddress> score;
+    std::vector<GoalAddress> goal;          // all of them; empty for no goal, only the best score
+};
+
+struct SearchResult {
+    bool reachedGoal{};
+    double score{};                         // of the best state found
+    std::vector<uint16_t> inputs;           // keypad of each step leading to it
+    unsigned int depth{};                   // deepest depth searched
+    uint64_t expanded{};                    // children run
+    uint64_t transpositions{};              // of them, states seen before
+    uint64_t kept{};                        // distinct states kept
+    uint64_t bytes{};                       // peak memory of nodes, table and snapshots
+    uint64_t stateBytes{};                  // one snapshot
+    double seconds{};
+};
+
+// "<address>:<weight>" score and "<address>=<value>" goal terms separated by
+// commas, numbers in C notation (0x2F0:1,0x2F1:0.01,0x300=1)
+bool ParseSearchTerms(const char* text, std::vector<ScoreAddress>& score, std::vector<GoalAddress>& goal);
+
+// hex digits of the keys to try one at a time besides no key ("456"); the
+// empty string for every key
+bool ParseSearchKeys(const char* text, std::vector<uint16_t>& actions);
+
+// false if the ROM cannot be loaded, with the reason in error
+bool RunSearch(const char* romFilename, const SearchConfig& config, SearchResult& result, std::string& error);
+
+// write inputs as a movie regression.h's LoadMovie reads: the frame each step starts on and its keypad
+bool WriteSearchMovie(const char* filename, const SearchConfig& config, const std::vector<uint16_t>& inputs);
+
+// search, report nodes/s and bytes per node, write the best path to movieFilename
+int RunSearchDriver(const char* romFilename, const SearchConfig& config, const char* movieFilename, std::ostream& out);
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+
+class Scheduler;
+
+// coroutine type returned by session driver functions
+class SessionTask {
+public:
+    struct promise_type {
+        SessionTask get_return_object() { return SessionTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }   // started by the scheduler
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        // coroutine frames are counted so memory per session can be measured
+        static void* operator new(size_t size);
+        static void operator delete(void* frame, size_t size);
+    };
+
+    SessionTask(SessionTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    SessionTask& operator=(SessionTask&& other) noexcept;
+    ~SessionTask();
+
+    bool Done() const { return !handle || handle.done(); }
+
+    // total bytes held by live coroutine frames
+    static size_t FrameBytes() { return frameBytes.load(std::memory_order_relaxed); }
+
+private:
+    friend class Scheduler;
+    explicit SessionTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+    static std::atomic<size_t> frameBytes;
+};
+
+// one emulator instance driven by a coroutine
+//
+//     SessionTask Run(Session& session) {
+//         for (;;) {
+//             co_await session.NextFrame();
+//             if (session.chip8.WaitingForKey()) {
+//                 co_await session.KeyPress();
+//             }
+//         }
+//     }
+class Session {
+public:
+    Session(const char* romFilename, unsigned int cyclesPerFrame);
+
+    Chip8 chip8;
+    LoadResult status;
+    unsigned int cyclesPerFrame;
+    uint64_t frame{};
+
+    // suspend until the scheduler has emulated the next frame (it stops early on an Fx0A wait)
+    struct FrameAwaiter {
+        Session& session;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+    };
+
+    // suspend until the scheduler delivers a key press, returns the key
+    struct KeyAwaiter {
+        Session& session;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle);
+        uint8_t await_resume() const noexcept { return session.lastKey; }
+    };
+
+    FrameAwaiter NextFrame() { return FrameAwaiter{ *this }; }
+    KeyAwaiter KeyPress() { return KeyAwaiter{ *this }; }
+
+private:
+    friend class Scheduler;
+
+    void EmulateFrame();
+
+    Scheduler* scheduler{};
+    std::coroutine_handle<> waiting;
+    bool waitingForKey{};
+    uint8_t lastKey{};
+};
+
+// multiplexes many sessions on the calling thread; with threads > 1 the
+// emulation of each frame is split between the calling thread and threads - 1
+// workers that live as long as the scheduler and wait between frames,
+// coroutines still resume here
+class Scheduler {
+public:
+    explicit Scheduler(unsigned int threads = 1);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void Spawn(Session& session, SessionTask task);
+
+    // resume sessions woken by keys, then emulate and resume every session waiting on a frame
+    void RunFrame();
+
+    // press or release a key; a press wakes a session suspended in KeyPress()
+    void PostKey(Session& session, uint8_t key, bool pressed);
+
+    size_t Active() const;
+
+private:
+    friend struct Session::FrameAwaiter;
+    friend struct Session::KeyAwaiter;
+
+    // emulate sessions of running, claimed a few at a time, until none are left
+    void EmulateRunning();
+    void Work();
+
+    unsigned int threads;
+    std::vector<SessionTask> tasks;
+    std::vector<std::coroutine_handle<>> ready;
+    std::vector<Session*> frameQueue;
+    std::vector<Session*> running;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;       // a frame started or the scheduler is going away
+    std::condition_variable finished;   // the last worker is done with the frame
+    uint64_t generation{};              // frames handed to the workers
+    unsigned int busy{};                // workers still on the current frame
+    bool stopping{};
+    std::atomic<size_t> next{};         // first session of running not claimed yet
+};
+
+// spawn count sessions of a ROM, run them for a number of frames and print
+// memory per suspended session and scheduling overhead per resume
+int MeasureSessions(const char* romFilename, size_t count, unsigned int frames, unsigned int threads);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// log-linear latency histogram in nanoseconds, every bucket within ~3% of its values
+class LatencyHistogram {
+public:
+    static const unsigned int SUB_BITS = 5;
+    static const unsigned int SUB_BUCKETS = 1u << SUB_BITS;
+    static const unsigned int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    void Record(uint64_t nanoseconds) {
+        ++buckets[Bucket(nanoseconds)];
+        ++count;
+        if (nanoseconds > max) {
+            max = nanoseconds;
+        }
+    }
+
+    uint64_t Count() const { return count; }
+    uint64_t Max() const { return max; }
+
+    // value at or below which the given fraction of samples fall, e.g. 0.99
+    uint64_t Percentile(double fraction) const;
+
+private:
+    static unsigned int Bucket(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<unsigned int>(value);
+        }
+
+        unsigned int magnitude = 63;
+        while (!(value >> magnitude)) {
+            --magnitude;
+        }
+
+        unsigned int shift = magnitude - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<unsigned int>((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    static uint64_t BucketValue(unsigned int bucket);
+
+    uint64_t buckets[BUCKETS]{};
+    uint64_t count{};
+    uint64_t max{};
+};
+
+// timings of the frontend phases of each frame
+class FrameTelemetry {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Phase { EMULATE, UPLOAD, PRESENT, PHASE_COUNT };
+
+    static const unsigned int RECENT_FRAMES = 128;
+
+    void Record(Phase phase, Clock::time_point start, Clock::time_point end) {
+        uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        histograms[phase].Record(nanoseconds);
+        recent[phase][frame % RECENT_FRAMES] = static_cast<uint32_t>(nanoseconds > UINT32_MAX ? UINT32_MAX : nanoseconds);
+    }
+
+    void EndFrame() { ++frame; }
+
+    const LatencyHistogram& Histogram(Phase phase) const { return histograms[phase]; }
+
+    // nanoseconds spent in a phase n frames ago (n = 1 is the last finished frame)
+    uint32_t Recent(Phase phase, unsigned int framesAgo) const {
+        return recent[phase][(frame - framesAgo) % RECENT_FRAMES];
+    }
+
+    uint64_t Frames() const { return frame; }
+
+    // phase,count,p50_us,p99_us,p999_us,max_us
+    bool WriteCsv(const char* filename) const;
+
+private:
+    LatencyHistogram histograms[PHASE_COUNT];
+    uint32_t recent[PHASE_COUNT][RECENT_FRAMES]{};
+    uint64_t frame{};
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "chip8.h"
+#include "debugger.h"
+
+// Execution history for reverse debugging. Forward execution goes through
+// Run, which keeps a Chip8State checkpoint every interval instructions and
+// records each keypad change with the instruction count it applies from.
+// Going back restores the nearest earlier checkpoint and re-executes
+// forward to the target; Cxkk replays the same bytes because the random
+// state is part of the snapshot.
+//
+//     Timeline timeline;
+//     timeline.Start(chip8);
+//     timeline.Run(chip8, debugger, 1000000);
+//     timeline.ReverseStep(chip8, 1);
+class Timeline {
+public:
+    explicit Timeline(uint64_t interval = 1024, size_t capacity = 2048);
+
+    // forget the history and start a new one at the machine's current state
+    void Start(const Chip8& chip8);
+
+    // execute forward like Debugger::Run, recording as it goes; history
+    // after the current position is dropped first, so a reverse step
+    // followed by different input starts a new branch
+    StopReason Run(Chip8& chip8, Debugger& debugger, uint64_t cycles, bool resume = true);
+
+    // go back count instructions, or to the oldest point kept; false if that was not far enough
+    bool ReverseStep(Chip8& chip8, uint64_t count);
+
+    // go back to the latest earlier point where PC was at a breakpoint;
+    // Limit if there is none and the machine is at the oldest point kept
+    StopReason ReverseContinue(Chip8& chip8, const Debugger& debugger);
+
+    // instructions executed since Start
+    uint64_t Position() const { return position; }
+    uint64_t Oldest() const { return checkpoints.empty() ? position : checkpoints.front().cycle; }
+
+    size_t Checkpoints() const { return checkpoints.size(); }
+    size_t MemoryUsage() const { return checkpoints.size() * sizeof(Checkpoint) + inputs.size() * sizeof(InputEvent); }
+
+private:
+    struct Checkpoint {
+        uint64_t cycle;
+        Chip8State state;
+    };
+
+    // keypad from cycle onwards, until the next event
+    struct InputEvent {
+        uint64_t cycle;
+        uint16_t keypad;
+    };
+
+    void Truncate();
+    void NoteInput(const Chip8& chip8);
+    void AddCheckpoint(const Chip8& chip8);
+
+    // restore checkpoint and run to target, applying recorded input; with
+    // breakpoints, returns the last cycle in [checkpoint, target) where PC
+    // was at one, otherwise UINT64_MAX
+    uint64_t Replay(Chip8& chip8, size_t checkpoint, uint64_t target, const Debugger* breakpoints);
+
+    uint64_t interval;
+    size_t capacity;
+    uint64_t position{};
+    std::deque<Checkpoint> checkpoints;
+    std::vector<InputEvent> inputs;     // sorted by cycle
+};
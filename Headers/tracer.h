@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#include "chip8.h"
+#include "mapped_file.h"
+
+// one executed instruction
+struct TraceRecord {
+    uint64_t cycle;
+    uint16_t pc;                // address of the instruction
+    uint16_t opcode;
+    uint16_t index;             // I after the instruction
+    uint16_t writes;            // bit n set if the instruction wrote Vn, VF included
+    uint8_t registers[16];      // V0 to VF after the instruction
+};
+
+static_assert(sizeof(TraceRecord) == 32, "trace records are written to disk as is");
+
+// TraceFileHeader flags
+const uint64_t TRACE_XO = 0x1;     // traced on an XO-CHIP machine, decode its opcodes
+
+// start of a trace file, followed by count records
+struct TraceFileHeader {
+    char magic[4];      // "C8TR"
+    uint32_t recordSize;
+    uint64_t count;
+    uint64_t dropped;   // records lost because the ring was full
+    uint64_t flags;
+};
+
+// Cycle policy writing a TraceRecord per instruction into a lock-free
+// single producer/single consumer ring. A background thread spills the ring
+// into a memory-mapped trace file. The core never waits: when the ring is
+// full the record is dropped and counted.
+//
+//     Tracer tracer("run.trace");
+//     chip8.Cycle(tracer);
+class Tracer {
+public:
+    explicit Tracer(const char* filename, size_t ringRecords = 1u << 22);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    template <typename Machine>
+    void Begin(const Machine&, uint16_t address, uint16_t) {
+        pc = address;
+        if constexpr (Machine::XO) {
+            flags = TRACE_XO;
+        }
+    }
+
+    template <typename Machine>
+    void End(const Machine& chip8, uint16_t opcode) {
+        uint64_t position = head.load(std::memory_order_relaxed);
+
+        // only look at the consumer's position when the ring seems full
+        if (position - cachedTail >= ring.size()) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position - cachedTail >= ring.size()) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                ++cycle;
+                return;
+            }
+        }
+
+        TraceRecord& record = ring[position & mask];
+        record.cycle = cycle++;
+        record.pc = pc;
+        record.opcode = opcode;
+        record.index = chip8.Index();
+        record.writes = WrittenRegisters<Machine>(opcode);
+        for (uint8_t reg = 0; reg < 16; ++reg) {
+            record.registers[reg] = chip8.Register(reg);
+        }
+
+        head.store(position + 1, std::memory_order_release);
+    }
+
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    // registers an instruction writes, as a mask of bit n for Vn
+    template <typename Machine>
+    static uint16_t WrittenRegisters(uint16_t opcode) {
+        const uint16_t VF = 1u << 0xF;
+        uint8_t x = (opcode & 0x0F00u) >> 8u;
+        uint8_t y = (opcode & 0x00F0u) >> 4u;
+        uint16_t Vx = static_cast<uint16_t>(1u << x);
+
+        switch (opcode >> 12u) {
+            case 0x5:
+                // XO-CHIP 5xy3 loads Vx through Vy, either direction
+                if (Machine::XO && (opcode & 0x000Fu) == 0x3) {
+                    uint8_t low = x < y ? x : y;
+                    uint8_t high = x < y ? y : x;
+                    return static_cast<uint16_t>(((2u << high) - 1u) & ~((1u << low) - 1u));
+                }
+                break;
+            case 0x6: case 0x7: case 0xC:
+                return Vx;
+            case 0x8:
+                switch (opcode & 0x000Fu) {
+                    case 0x0:
+                        return Vx;
+                    case 0x1: case 0x2: case 0x3:
+                        return Machine::LOGIC_RESETS_VF ? Vx | VF : Vx;
+                    case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+                        return Vx | VF;
+                }
+                break;
+            case 0xD:
+                return VF;
+            case 0xF:
+                switch (opcode & 0x00FFu) {
+                    case 0x07: case 0x0A:
+                        return Vx;
+                    case 0x65: case 0x85:
+                        return static_cast<uint16_t>((2u << x) - 1u);
+                }
+                break;
+        }
+
+        return 0;
+    }
+
+    void Spill();
+    bool Grow(uint64_t records);
+
+    std::vector<TraceRecord> ring;
+    size_t mask;
+    uint64_t cycle{};
+    uint64_t cachedTail{};
+    uint16_t pc{};
+    uint64_t flags{};
+
+    alignas(64) std::atomic<uint64_t> head{ 0 };    // written by the core
+    alignas(64) std::atomic<uint64_t> tail{ 0 };    // written by the spill thread
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> stop{ false };
+
+    const char* filename;
+    MappedFile file;
+    uint64_t written{};
+    std::thread thread;
+};
+
+// print a trace file as disassembly, one line per record
+int DecodeTrace(const char* filename, std::ostream& out);
@@ -0,0 +1,366 @@
+#include "analyzer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "disassembler.h"
+#include "profiler.h"
+
+
+static bool IsSkip(OpcodeHandler handler) {
+	return handler == HANDLER_3xkk || handler == HANDLER_4xkk || handler == HANDLER_5xy0
+		|| handler == HANDLER_9xy0 || handler == HANDLER_Ex9E || handler == HANDLER_ExA1;
+}
+
+// instruction that ends a basic block
+static bool EndsBlock(OpcodeHandler handler) {
+	return IsSkip(handler) || handler == HANDLER_00EE || handler == HANDLER_1nnn
+		|| handler == HANDLER_2nnn || handler == HANDLER_Bnnn || handler == HANDLER_00FD;
+}
+
+static void MarkData(RomAnalysis& analysis, unsigned int start, unsigned int length) {
+	for (unsigned int i = 0; i < length; ++i) {
+		analysis.flags[(start + i) & 0x0FFFu] |= BYTE_DATA;
+	}
+}
+
+// I values an instruction is analysed with at most; past that, further paths stop there
+const size_t MAX_INDEX_VALUES = 8;
+
+void AnalyzeRom(std::span<const uint8_t> rom, RomAnalysis& analysis) {
+	size_t size = std::min<size_t>(rom.size(), MAX_ROM_SIZE);
+
+	memset(analysis.memory, 0, sizeof(analysis.memory));
+	memcpy(analysis.memory + START_ADDRESS, rom.data(), size);
+	analysis.romEnd = static_cast<uint16_t>(START_ADDRESS + size);
+
+	auto inRom = [&analysis](unsigned int address) {
+		return address >= START_ADDRESS && address + 1 < analysis.romEnd;
+	};
+
+	// bytes read as sprites or by Fx65 through a known I; never decoded as
+	// code, and the walk is redone whenever a new one turns up on a path
+	// already taken, since whatever that path reached past it may be data too
+	std::vector<bool> read(sizeof(analysis.memory));
+
+	// Bnnn tables by start address and their number of jump entries
+	std::vector<std::pair<uint16_t, unsigned int>> tables;
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		memset(analysis.flags, 0, sizeof(analysis.flags));
+		analysis.blocks.clear();
+		analysis.subroutines.clear();
+		tables.clear();
+
+		// I values each instruction was reached with: a subroutine drawing
+		// sprites at several addresses is walked once per address
+		std::vector<std::vector<int>> indexValues(sizeof(analysis.memory));
+
+		// addresses to disassemble from, with the I value known on the way there (-1 if unknown)
+		std::vector<std::pair<uint16_t, int>> work;
+		work.push_back({ static_cast<uint16_t>(START_ADDRESS), -1 });
+		analysis.flags[START_ADDRESS] |= BYTE_LEADER;
+
+		// Bnnn targets, resolved once no other path is left so the code they run into is known
+		std::vector<std::pair<uint16_t, int>> pendingTables;
+
+		auto branchTo = [&](unsigned int target, int knownIndex) {
+			if (inRom(target)) {
+				analysis.flags[target] |= BYTE_LEADER;
+				work.push_back({ static_cast<uint16_t>(target), knownIndex });
+			}
+		};
+
+		auto visit = [&](unsigned int address, int knownIndex) {
+			std::vector<int>& seen = indexValues[address];
+			if (seen.size() >= MAX_INDEX_VALUES || std::find(seen.begin(), seen.end(), knownIndex) != seen.end()) {
+				return false;
+			}
+			seen.push_back(knownIndex);
+			return true;
+		};
+
+		auto markRead = [&](unsigned int start, unsigned int length) {
+			for (unsigned int i = 0; i < length; ++i) {
+				unsigned int address = (start + i) & 0x0FFFu;
+				if (!read[address]) {
+					read[address] = true;
+					changed |= (analysis.flags[address] & BYTE_CODE) != 0;
+				}
+			}
+			MarkData(analysis, start, length);
+		};
+
+		while (!work.empty() || !pendingTables.empty()) {
+			if (work.empty()) {
+				auto [table, knownIndex] = pendingTables.back();
+				pendingTables.pop_back();
+
+				auto resolved = std::find_if(tables.begin(), tables.end(), [table](const auto& entry) { return entry.first == table; });
+				if (resolved == tables.end()) {
+					// jump table: 1nnn/2nnn entries, up to code or data reached some
+					// other way or the target of an earlier entry
+					unsigned int entries = 0;
+					for (unsigned int offset = 0; offset < 256 && inRom(table + offset); offset += 2, ++entries) {
+						unsigned int address = table + offset;
+						OpcodeHandler handler = DecodeHandler(analysis.Opcode(address));
+
+						if ((handler != HANDLER_1nnn && handler != HANDLER_2nnn) || read[address] || read[address + 1]) {
+							break;
+						}
+						if (offset > 0 && (analysis.flags[address] & (BYTE_LEADER | BYTE_CODE | BYTE_DATA))) {
+							break;
+						}
+
+						bool target = false;
+						for (unsigned int earlier = table; earlier < address; earlier += 2) {
+							target |= (analysis.Opcode(earlier) & 0x0FFFu) == address;
+						}
+						if (target) {
+							break;
+						}
+					}
+					resolved = tables.insert(tables.end(), { table, entries });
+				}
+
+				for (unsigned int entry = 0; entry < resolved->second; ++entry) {
+					branchTo(table + 2 * entry, knownIndex);
+				}
+				continue;
+			}
+
+			unsigned int address = work.back().first;
+			int knownIndex = work.back().second;
+			work.pop_back();
+
+			while (inRom(address) && !read[address] && !read[address + 1] && visit(address, knownIndex)) {
+				uint16_t opcode = analysis.Opcode(address);
+				OpcodeHandler handler = DecodeHandler(opcode);
+
+				// 0nnn (SYS) is ignored by the core, anything else unknown ends the path as data
+				if (handler == HANDLER_NULL && (opcode & 0xF000u) != 0) {
+					break;
+				}
+
+				analysis.flags[address] |= BYTE_INSTRUCTION | BYTE_CODE;
+				analysis.flags[address + 1] |= BYTE_CODE;
+
+				unsigned int next = address + 2;
+				unsigned int x = (opcode & 0x0F00u) >> 8u;
+
+				switch (handler) {
+					case HANDLER_Annn: knownIndex = opcode & 0x0FFF; break;
+					case HANDLER_Fx1E: case HANDLER_Fx29: case HANDLER_Fx30: knownIndex = -1; break;
+					case HANDLER_Dxyn: if (knownIndex >= 0) markRead(knownIndex, (opcode & 0x000Fu) ? opcode & 0x000Fu : 32); break;
+					case HANDLER_Fx33: if (knownIndex >= 0) MarkData(analysis, knownIndex, 3); break;
+					case HANDLER_Fx55: if (knownIndex >= 0) MarkData(analysis, knownIndex, x + 1); break;
+					case HANDLER_Fx65: if (knownIndex >= 0) markRead(knownIndex, x + 1); break;
+					default: break;
+				}
+
+				if (!EndsBlock(handler)) {
+					address = next;
+					continue;
+				}
+
+				analysis.flags[next & 0x0FFFu] |= inRom(next) ? BYTE_LEADER : 0;
+
+				if (IsSkip(handler)) {
+					branchTo(next, knownIndex);
+					branchTo(next + 2, knownIndex);
+				}
+				else if (handler == HANDLER_1nnn) {
+					branchTo(opcode & 0x0FFFu, knownIndex);
+				}
+				else if (handler == HANDLER_2nnn) {
+					// the callee may change I
+					branchTo(opcode & 0x0FFFu, knownIndex);
+					branchTo(next, -1);
+					analysis.subroutines.push_back(opcode & 0x0FFFu);
+				}
+				else if (handler == HANDLER_Bnnn && inRom(opcode & 0x0FFFu)) {
+					analysis.flags[opcode & 0x0FFFu] |= BYTE_LEADER;
+					pendingTables.push_back({ static_cast<uint16_t>(opcode & 0x0FFFu), knownIndex });
+				}
+				break;
+			}
+		}
+	}
+
+	std::sort(analysis.subroutines.begin(), analysis.subroutines.end());
+	analysis.subroutines.erase(std::unique(analysis.subroutines.begin(), analysis.subroutines.end()), analysis.subroutines.end());
+
+	// split the discovered instructions into blocks
+	for (unsigned int address = START_ADDRESS; address < analysis.romEnd; ++address) {
+		if (!(analysis.flags[address] & BYTE_INSTRUCTION) || !(analysis.flags[address] & BYTE_LEADER)) {
+			continue;
+		}
+
+		BasicBlock block{};
+		block.start = static_cast<uint16_t>(address);
+
+		unsigned int current = address;
+		for (;;) {
+			uint16_t opcode = analysis.Opcode(current);
+			OpcodeHandler handler = DecodeHandler(opcode);
+			unsigned int next = current + 2;
+
+			if (EndsBlock(handler)) {
+				if (IsSkip(handler)) {
+					block.successors = { static_cast<uint16_t>(next), static_cast<uint16_t>(next + 2) };
+				}
+				else if (handler == HANDLER_1nnn) {
+					block.successors = { static_cast<uint16_t>(opcode & 0x0FFFu) };
+				}
+				else if (handler == HANDLER_2nnn) {
+					block.call = opcode & 0x0FFFu;
+					block.successors = { static_cast<uint16_t>(next) };
+				}
+				else if (handler == HANDLER_Bnnn) {
+					block.indirect = true;
+					unsigned int table = opcode & 0x0FFFu;
+					auto resolved = std::find_if(tables.begin(), tables.end(), [table](const auto& entry) { return entry.first == table; });
+					for (unsigned int entry = 0; resolved != tables.end() && entry < resolved->second; ++entry) {
+						block.successors.push_back(static_cast<uint16_t>(table + 2 * entry));
+					}
+				}
+				else if (handler == HANDLER_00FD) {
+					// the machine stops here
+				}
+				else {
+					block.returns = true;
+				}
+				block.end = static_cast<uint16_t>(next);
+				break;
+			}
+
+			// falls into the next block, or runs off into data
+			if (!inRom(next) || !(analysis.flags[next] & BYTE_INSTRUCTION) || (analysis.flags[next] & BYTE_LEADER)) {
+				if (inRom(next) && (analysis.flags[next] & BYTE_INSTRUCTION)) {
+					block.successors = { static_cast<uint16_t>(next) };
+				}
+				block.end = static_cast<uint16_t>(next);
+				break;
+			}
+
+			current = next;
+		}
+
+		analysis.blocks.push_back(std::move(block));
+	}
+}
+
+const BasicBlock* RomAnalysis::BlockAt(uint16_t address) const {
+	auto found = std::lower_bound(blocks.begin(), blocks.end(), address, [](const BasicBlock& block, uint16_t value) {
+		return block.start < value;
+	});
+
+	return found != blocks.end() && found->start == address ? &*found : nullptr;
+}
+
+static void WriteInstruction(const RomAnalysis& analysis, uint16_t address, std::ostream& out, const char* lineEnd) {
+	char text[48];
+	uint16_t opcode = analysis.Opcode(address);
+	snprintf(text, sizeof(text), "%03X  %04X  %s", address, opcode, Disassemble(opcode).c_str());
+	out << text << lineEnd;
+}
+
+void WriteAnalysisText(const RomAnalysis& analysis, std::ostream& out) {
+	char text[32];
+
+	for (const BasicBlock& block : analysis.blocks) {
+		snprintf(text, sizeof(text), "block %03X-%03X", block.start, block.end);
+		out << text;
+
+		if (std::binary_search(analysis.subroutines.begin(), analysis.subroutines.end(), block.start)) {
+			out << " (subroutine)";
+		}
+		out << " ->";
+		for (uint16_t successor : block.successors) {
+			snprintf(text, sizeof(text), " %03X", successor);
+			out << text;
+		}
+		if (block.call) {
+			snprintf(text, sizeof(text), " call %03X", block.call);
+			out << text;
+		}
+		out << (block.indirect ? " (indirect)" : "") << (block.returns ? " ret" : "") << "\n";
+
+		for (uint16_t address = block.start; address < block.end; address += 2) {
+			out << "    ";
+			WriteInstruction(analysis, address, out, "\n");
+		}
+	}
+
+	// data ranges, 8 bytes per line
+	for (unsigned int address = START_ADDRESS; address < analysis.romEnd; ) {
+		if (!(analysis.flags[address] & BYTE_DATA)) {
+			++address;
+			continue;
+		}
+
+		snprintf(text, sizeof(text), "data  %03X ", address);
+		out << text;
+		for (unsigned int i = 0; i < 8 && address < analysis.romEnd && (analysis.flags[address] & BYTE_DATA); ++i, ++address) {
+			snprintf(text, sizeof(text), " %02X", analysis.memory[address]);
+			out << text;
+		}
+		out << "\n";
+	}
+}
+
+void WriteAnalysisDot(const RomAnalysis& analysis, std::ostream& out) {
+	char text[32];
+
+	out << "digraph rom {\n  node [shape=box, fontname=\"monospace\"];\n";
+
+	for (const BasicBlock& block : analysis.blocks) {
+		snprintf(text, sizeof(text), "  b%03X [label=\"", block.start);
+		out << text;
+		for (uint16_t address = block.start; address < block.end; address += 2) {
+			WriteInstruction(analysis, address, out, "\\l");
+		}
+		out << "\"];\n";
+
+		for (uint16_t successor : block.successors) {
+			snprintf(text, sizeof(text), "  b%03X -> b%03X", block.start, successor);
+			out << text << (block.indirect ? " [color=blue]" : "") << ";\n";
+		}
+		if (block.call) {
+			snprintf(text, sizeof(text), "  b%03X -> b%03X", block.start, block.call);
+			out << text << " [style=dashed];\n";
+		}
+	}
+
+	out << "}\n";
+}
+
+int AnalyzeRomFile(const char* filename, bool dot, std::ostream& out) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		out << "Cannot load " << filename << ": " << LoadResultMessage(LoadResult::FileNotFound) << "\n";
+		return 1;
+	}
+
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (rom.size() > MAX_ROM_SIZE) {
+		out << "Cannot load " << filename << ": " << LoadResultMessage(LoadResult::TooLarge) << "\n";
+		return 1;
+	}
+
+	RomAnalysis analysis;
+	AnalyzeRom(rom, analysis);
+
+	if (dot) {
+		WriteAnalysisDot(analysis, out);
+	}
+	else {
+		WriteAnalysisText(analysis, out);
+	}
+
+	return 0;
+}
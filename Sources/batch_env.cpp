@@ -0,0 +1,154 @@
+#include "batch_env.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+BatchEnv::BatchEnv(const char* romFilename, size_t numEnvs, const EnvConfig& config) : config(config) {
+	// boot one machine and cache its state, every instance starts from this snapshot
+	Chip8 boot;
+	status = boot.LoadROM(romFilename);
+
+	for (unsigned int frame = 0; frame < config.bootFrames; ++frame) {
+		for (unsigned int cycle = 0; cycle < config.cyclesPerFrame; ++cycle) {
+			boot.Cycle();
+		}
+	}
+
+	boot.SaveState(bootState);
+
+	envs.assign(numEnvs, boot);
+	lastRewardValues.assign(numEnvs * config.rewards.size(), 0);
+	frames.assign(numEnvs, 0);
+	episodes.assign(numEnvs, 0);
+
+	for (size_t env = 0; env < numEnvs; ++env) {
+		ResetEnv(env);
+	}
+}
+
+size_t BatchEnv::ObservationSize() const {
+	if (config.format == ObservationFormat::Bits1) {
+		return VIDEO_WIDTH * VIDEO_HEIGHT / 8;
+	}
+	return VIDEO_WIDTH * VIDEO_HEIGHT;
+}
+
+void BatchEnv::Reset(uint8_t* observations) {
+	for (size_t env = 0; env < envs.size(); ++env) {
+		ResetEnv(env);
+		WriteObservation(env, observations);
+	}
+}
+
+void BatchEnv::Step(const uint16_t* actions, uint8_t* observations, float* rewards, uint8_t* dones) {
+	const size_t numRewards = config.rewards.size();
+
+	for (size_t env = 0; env < envs.size(); ++env) {
+		Chip8& chip8 = envs[env];
+
+		// hold the action for the whole frame skip
+		chip8.keypad = actions[env];
+
+		for (unsigned int frame = 0; frame < config.frameSkip; ++frame) {
+			for (unsigned int cycle = 0; cycle < config.cyclesPerFrame; ++cycle) {
+				chip8.Cycle();
+			}
+		}
+		frames[env] += config.frameSkip;
+
+		// reward is the weighted change of the watched bytes
+		float reward = 0.0f;
+		uint8_t* last = &lastRewardValues[env * numRewards];
+		for (size_t i = 0; i < numRewards; ++i) {
+			uint8_t value = chip8.ReadMemory(config.rewards[i].address);
+			reward += config.rewards[i].weight * (static_cast<int>(value) - static_cast<int>(last[i]));
+			last[i] = value;
+		}
+		rewards[env] = reward;
+
+		bool done = IsDone(env);
+		dones[env] = done;
+
+		if (done) {
+			ResetEnv(env);
+		}
+
+		WriteObservation(env, observations);
+	}
+}
+
+void BatchEnv::ResetEnv(size_t env) {
+	Chip8& chip8 = envs[env];
+
+	chip8.LoadState(bootState);
+	frames[env] = 0;
+
+	// the snapshot carries the boot machine's random state; give every
+	// instance and every episode its own Cxkk stream
+	chip8.Seed(static_cast<unsigned int>(episodes[env]++ * envs.size() + env));
+
+	uint8_t* last = &lastRewardValues[env * config.rewards.size()];
+	for (size_t i = 0; i < config.rewards.size(); ++i) {
+		last[i] = chip8.ReadMemory(config.rewards[i].address);
+	}
+}
+
+void BatchEnv::WriteObservation(size_t env, uint8_t* observations) const {
+	uint8_t* out = observations + env * ObservationSize();
+
+	if (config.format == ObservationFormat::Bits1) {
+		envs[env].PackVideo1bpp(out);
+	}
+	else {
+		envs[env].PackVideo8bpp(out);
+	}
+}
+
+bool BatchEnv::IsDone(size_t env) const {
+	if (config.maxFrames && frames[env] >= config.maxFrames) {
+		return true;
+	}
+
+	if (config.useDoneAddress) {
+		uint8_t value = envs[env].ReadMemory(config.doneAddress);
+		return (value & config.doneMask) == config.doneValue;
+	}
+
+	return false;
+}
+
+int CheckBatchDiversity(const char* romFilename, size_t count, unsigned int steps) {
+	EnvConfig config;
+	config.maxFrames = steps / 2 * config.frameSkip;
+	BatchEnv batch(romFilename, count, config);
+	if (batch.Status() != LoadResult::Ok) {
+		std::cerr << romFilename << ": " << LoadResultMessage(batch.Status()) << "\n";
+		return 1;
+	}
+
+	std::vector<uint16_t> actions(count, 0);
+	std::vector<uint8_t> observations(count * batch.ObservationSize());
+	std::vector<float> rewards(count);
+	std::vector<uint8_t> dones(count);
+
+	// FNV-1a of every frame an instance saw in each of its two episodes
+	std::vector<uint64_t> hashes(2 * count, 14695981039346656037ull);
+	batch.Reset(observations.data());
+	for (unsigned int step = 0; step < steps / 2 * 2; ++step) {
+		batch.Step(actions.data(), observations.data(), rewards.data(), dones.data());
+		for (size_t env = 0; env < count; ++env) {
+			uint64_t& hash = hashes[2 * env + step / (steps / 2)];
+			const uint8_t* observation = &observations[env * batch.ObservationSize()];
+			for (size_t i = 0; i < batch.ObservationSize(); ++i) {
+				hash = (hash ^ observation[i]) * 1099511628211ull;
+			}
+		}
+	}
+
+	std::vector<uint64_t> sorted = hashes;
+	std::sort(sorted.begin(), sorted.end());
+	size_t distinct = std::unique(sorted.begin(), sorted.end()) - sorted.begin();
+	std::cout << count << " instance(s) x 2 episode(s) of " << steps / 2 << " steps: " << distinct << " distinct of " << hashes.size() << "\n";
+	return distinct == hashes.size() ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "chip8.h"
+
+
+using Clock = std::chrono::steady_clock;
+
+const unsigned int REPETITIONS = 7;
+const unsigned int BENCH_SEED = 1;
+
+struct BenchResult {
+	std::string name;
+	double nsPerOp;     // median of the repetitions
+	double minNsPerOp;
+};
+
+// time REPETITIONS runs of body(iterations), each returning after that many operations
+static BenchResult Measure(const std::string& name, unsigned int iterations, const std::function<void(unsigned int)>& body) {
+	body(iterations / 10 + 1);	// warm up
+
+	std::vector<double> samples;
+	for (unsigned int rep = 0; rep < REPETITIONS; ++rep) {
+		auto start = Clock::now();
+		body(iterations);
+		samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations);
+	}
+
+	std::sort(samples.begin(), samples.end());
+	return BenchResult{ name, samples[samples.size() / 2], samples[0] };
+}
+
+// machine whose whole program area repeats one instruction, ending in a jump back to the start
+static Chip8State RepeatedInstruction(uint16_t opcode) {
+	Chip8 chip8;
+	Chip8State state;
+	chip8.SaveState(state);
+
+	for (unsigned int address = START_ADDRESS; address + 3 < sizeof(state.memory); address += 2) {
+		state.memory[address] = opcode >> 8u;
+		state.memory[address + 1] = opcode & 0xFFu;
+	}
+	state.memory[sizeof(state.memory) - 2] = 0x10 | (START_ADDRESS >> 8u);
+	state.memory[sizeof(state.memory) - 1] = START_ADDRESS & 0xFFu;
+
+	// sprite data for Dxyn, I points at it
+	for (unsigned int i = 0; i < 32; ++i) {
+		state.memory[i] = 0xA5;
+	}
+
+	for (uint8_t reg = 0; reg < 16; ++reg) {
+		state.registers[reg] = 0x11 * reg + 3;
+	}
+
+	state.index = 0;
+	state.pc = START_ADDRESS;
+	return state;
+}
+
+static BenchResult MeasureInstruction(const std::string& name, uint16_t opcode, uint8_t vx = 0, uint8_t vy = 0, bool hires = false) {
+	Chip8State state = RepeatedInstruction(opcode);
+	state.hires = hires;
+	state.registers[(opcode & 0x0F00u) >> 8u] = vx;
+	if ((opcode & 0xF000u) == 0xD000u) {
+		state.registers[(opcode & 0x00F0u) >> 4u] = vy;
+	}
+
+	Chip8 chip8;
+	chip8.Seed(BENCH_SEED);
+	chip8.LoadState(state);
+
+	return Measure(name, 1000000, [&chip8](unsigned int iterations) {
+		for (unsigned int i = 0; i < iterations; ++i) {
+			chip8.Cycle();
+		}
+	});
+}
+
+static BenchResult MeasureRom(const std::string& name, const std::string& filename, unsigned int cycles) {
+	Chip8 chip8;
+	chip8.LoadROM(filename.c_str());
+	chip8.Seed(BENCH_SEED);
+
+	Chip8State boot;
+	chip8.SaveState(boot);
+
+	// every repetition replays the same run from power on
+	return Measure(name, cycles, [&chip8, &boot](unsigned int iterations) {
+		chip8.LoadState(boot);
+		chip8.Seed(BENCH_SEED);
+		for (unsigned int i = 0; i < iterations; ++i) {
+			chip8.Cycle();
+		}
+	});
+}
+
+int RunBenchmarks(const char* jsonFilename, const char* romDirectory) {
+	std::string roms = std::string(romDirectory) + "/";
+	std::vector<BenchResult> results;
+
+	for (const char* rom : { "test_opcode.ch8", "Tetris.ch8" }) {
+		LoadResult loaded = Chip8().LoadROM((roms + rom).c_str());
+		if (loaded != LoadResult::Ok) {
+			std::cerr << "Cannot load " << roms + rom << ": " << LoadResultMessage(loaded) << "\n";
+			return 1;
+		}
+	}
+
+	// dispatch: one level (6xkk), two levels to an empty handler (0001)
+	results.push_back(MeasureInstruction("dispatch/6xkk", 0x6A12));
+	results.push_back(MeasureInstruction("dispatch/null", 0x0001));
+
+	static const uint8_t aluOps[] = { 0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7, 0xE };
+	for (uint8_t op : aluOps) {
+		char name[16];
+		snprintf(name, sizeof(name), "alu/8xy%X", op);
+		results.push_back(MeasureInstruction(name, 0x8120 | op, 0x35));
+	}
+
+	// draws toggle the same pixels back and forth, so collisions happen every other draw
+	results.push_back(MeasureInstruction("draw/h1_aligned", 0xD121, 8, 8));
+	results.push_back(MeasureInstruction("draw/h8_aligned", 0xD128, 8, 8));
+	results.push_back(MeasureInstruction("draw/h15_aligned", 0xD12F, 8, 8));
+	results.push_back(MeasureInstruction("draw/h8_unaligned", 0xD128, 13, 5));
+	results.push_back(MeasureInstruction("draw/h15_edge", 0xD12F, 60, 28));
+
+	// SCHIP: 16x16 sprites within a word and across the word boundary of a 128-pixel row, whole-screen scrolls
+	results.push_back(MeasureInstruction("schip/draw16_hires", 0xD120, 8, 8, true));
+	results.push_back(MeasureInstruction("schip/draw16_hires_straddle", 0xD120, 56, 8, true));
+	results.push_back(MeasureInstruction("schip/draw8_hires_straddle", 0xD128, 60, 8, true));
+	results.push_back(MeasureInstruction("schip/scroll_down", 0x00C4));
+	results.push_back(MeasureInstruction("schip/scroll_down_hires", 0x00C4, 0, 0, true));
+	results.push_back(MeasureInstruction("schip/scroll_right", 0x00FB));
+	results.push_back(MeasureInstruction("schip/scroll_right_hires", 0x00FB, 0, 0, true));
+	results.push_back(MeasureInstruction("schip/scroll_left_hires", 0x00FC, 0, 0, true));
+
+	results.push_back(MeasureInstruction("mem/Fx33", 0xF133, 0xEF));
+	results.push_back(MeasureInstruction("mem/Fx55", 0xFF55));
+	results.push_back(MeasureInstruction("mem/Fx65", 0xFF65));
+
+	{
+		std::string tetris = roms + "Tetris.ch8";
+		results.push_back(Measure("load/LoadROM", 2000, [&tetris](unsigned int iterations) {
+			Chip8 chip8;
+			for (unsigned int i = 0; i < iterations; ++i) {
+				chip8.LoadROM(tetris.c_str());
+			}
+		}));
+
+		// same ROM from a buffer, as served by a ROM cache
+		std::vector<uint8_t> image;
+		{
+			std::ifstream file(tetris, std::ios::binary);
+			image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		results.push_back(Measure("load/LoadROM_span", 100000, [&image](unsigned int iterations) {
+			Chip8 chip8;
+			for (unsigned int i = 0; i < iterations; ++i) {
+				chip8.LoadROM(std::span<const uint8_t>(image));
+			}
+		}));
+
+		results.push_back(Measure("load/construct", 100000, [](unsigned int iterations) {
+			for (unsigned int i = 0; i < iterations; ++i) {
+				Chip8 chip8;
+				volatile uint8_t sink = chip8.ReadMemory(START_ADDRESS);
+				(void)sink;
+			}
+		}));
+	}
+
+	results.push_back(MeasureRom("rom/test_opcode", roms + "test_opcode.ch8", 1000000));
+	results.push_back(MeasureRom("rom/Tetris", roms + "Tetris.ch8", 1000000));
+
+	std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "ns/op" << std::setw(14) << "min ns/op" << "\n";
+	for (const BenchResult& result : results) {
+		std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(14) << result.nsPerOp << std::setw(14) << result.minNsPerOp << "\n";
+	}
+
+	if (jsonFilename) {
+		std::ofstream file(jsonFilename);
+		if (!file.is_open()) {
+			std::cerr << "cannot write " << jsonFilename << "\n";
+			return 1;
+		}
+
+		file << "{\n  \"seed\": " << BENCH_SEED << ",\n  \"benchmarks\": [";
+		for (size_t i = 0; i < results.size(); ++i) {
+			file << (i ? "," : "") << "\n    { \"name\": \"" << results[i].name << "\", \"ns_per_op\": "
+				<< results[i].nsPerOp << ", \"min_ns_per_op\": " << results[i].minNsPerOp << " }";
+		}
+		file << "\n  ]\n}\n";
+	}
+
+	return 0;
+}
+
+// reads the "name" / "ns_per_op" pairs written by RunBenchmarks
+static bool ReadResults(const char* filename, std::map<std::string, double>& results) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		std::cerr << "cannot read " << filename << "\n";
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t name = line.find("\"name\": \"");
+		size_t value = line.find("\"ns_per_op\": ");
+		if (name == std::string::npos || value == std::string::npos) {
+			continue;
+		}
+
+		name += 9;
+		results[line.substr(name, line.find('"', name) - name)] = std::stod(line.substr(value + 13));
+	}
+
+	return true;
+}
+
+int CompareBenchmarks(const char* baselineFilename, const char* currentFilename, double thresholdPercent) {
+	std::map<std::string, double> baseline;
+	std::map<std::string, double> current;
+
+	if (!ReadResults(baselineFilename, baseline) || !ReadResults(currentFilename, current)) {
+		return 2;
+	}
+
+	int regressions = 0;
+
+	std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(14) << "baseline" << std::setw(14) << "current" << std::setw(10) << "change" << "\n";
+	for (const auto& entry : current) {
+		auto found = baseline.find(entry.first);
+		if (found == baseline.end() || found->second <= 0) {
+			continue;
+		}
+
+		double change = 100.0 * (entry.second - found->second) / found->second;
+		bool regressed = change > thresholdPercent;
+		regressions += regressed;
+
+		std::cout << std::left << std::setw(28) << entry.first << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(14) << found->second << std::setw(14) << entry.second
+			<< std::setw(9) << std::showpos << change << std::noshowpos << "%" << (regressed ? "  REGRESSION" : "") << "\n";
+	}
+
+	std::cout << regressions << " regression(s) beyond " << thresholdPercent << "%\n";
+	return regressions ? 1 : 0;
+}
@@ -22,115 +22,415 @@ uint8_t fontset[FONTSET_SIZE] =
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+uint8_t bigFontset[BIG_FONTSET_SIZE] =
+{
+	0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C, // 0
+	0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, // 1
+	0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF, // 2
+	0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C, // 3
+	0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06, // 4
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C, // 5
+	0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C, // 6
+	0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60, // 7
+	0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C, // 8
+	0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C, // 9
+	0x18, 0x3C, 0x66, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+	0xFC, 0xFE, 0xC3, 0xC3, 0xFE, 0xFE, 0xC3, 0xC3, 0xFE, 0xFC, // B
+	0x3C, 0x7E, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0x7E, 0x3C, // C
+	0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xFF, 0xFF, // E
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFC, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+
+// Zobrist keys of the display: a random word per plane and pixel, the frame
+// hash is the XOR of the keys of the lit pixels, so flipping pixels updates
+// it by XOR. Keys come grouped by nibble, key[plane][row][n][m] being the
+// keys of the pixels set in m at bits 4n to 4n + 3 of the row (bit 0 the
+// LSB of the first word, bit 64 that of the second). The padding nibbles
+// past the row are all zero so a sprite row can always hash a fixed number
+// of nibbles. HIRES_KEY tells the two resolutions apart.
+const unsigned int ROW_KEY_NIBBLES = HIRES_WIDTH / 4 + 16 / 4;
+
+struct DisplayKeys {
+	uint64_t key[PlaneCount(XO_MEMORY_SIZE)][HIRES_HEIGHT][ROW_KEY_NIBBLES][16];
+};
+
+static DisplayKeys displayKeys;
+static const uint64_t HIRES_KEY = 0xD6E8FEB86659FD93ull;
+
+// filled by the first machine constructed, the same keys in every run
+static const DisplayKeys& DisplayHashKeys() {
+	static const bool ready = []() {
+		uint64_t state = 0x0123456789ABCDEFull;	// splitmix64
+		for (auto& plane : displayKeys.key) {
+			for (auto& row : plane) {
+				for (unsigned int n = 0; n < HIRES_WIDTH / 4; ++n) {
+					uint64_t pixels[4];
+					for (uint64_t& pixel : pixels) {
+						uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+						z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+						z = (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+						pixel = z ^ (z >> 31u);
+					}
+					for (unsigned int m = 0; m < 16; ++m) {
+						for (unsigned int bit = 0; bit < 4; ++bit) {
+							row[n][m] ^= m & (1u << bit) ? pixels[bit] : 0;
+						}
+					}
+				}
+			}
+		}
+		return true;
+	}();
+	(void)ready;
+	return displayKeys;
+}
+
+// keys of the set bits of a row word, all of which lie in the Nibbles nibbles
+// from first; keys start at the word's nibble 0. A fixed number of lookups
+// and no branches on the pixels, empty nibbles have key 0.
+template <unsigned int Nibbles>
+static uint64_t HashSpriteRow(const uint64_t (*keys)[16], uint64_t bits, unsigned int first) {
+	uint64_t hash = 0;
+	bits >>= 4 * first;
+	keys += first;
+	for (unsigned int n = 0; n < Nibbles; ++n) {
+		hash ^= keys[n][(bits >> (4 * n)) & 0xFu];
+	}
+	return hash;
+}
+
+// a plane of height rows of words words, skipping empty nibbles; nothing
+// outside the current resolution is ever lit
+static uint64_t HashPlane(const uint64_t (*video)[VIDEO_ROW_WORDS], unsigned int plane, unsigned int height = HIRES_HEIGHT, unsigned int words = VIDEO_ROW_WORDS) {
+	const DisplayKeys& keys = DisplayHashKeys();
+	uint64_t hash = 0;
+	for (unsigned int row = 0; row < height; ++row) {
+		for (unsigned int word = 0; word < words; ++word) {
+			for (uint64_t bits = video[row][word]; bits;) {
+				unsigned int shift = std::countr_zero(bits) & ~3u;
+				hash ^= keys.key[plane][row][word * 16 + shift / 4][(bits >> shift) & 0xFu];
+				bits &= ~(0xFull << shift);
+			}
+		}
+	}
+	return hash;
+}
+
+// Memory is hashed a word of 8 bytes at a time: a write XORs out the
+// WordKey of the words it covers and XORs in their new ones. The memory hash
+// is the XOR over the nonzero words of WordKey(word, value) ^ WordKey(word, 0),
+// so zeroed memory hashes to 0.
+static uint64_t WordKey(unsigned int word, uint64_t value) {
+	uint64_t z = value ^ (word * 0x9E3779B97F4A7C15ull);	// splitmix64 finalizer
+	z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31u);
+}
+
+// WordKeys of the words holding bytes begin to end - 1, for an update
+static uint64_t HashWords(const uint8_t* memory, unsigned int begin, unsigned int end) {
+	uint64_t hash = 0;
+	for (unsigned int word = begin / 8; word < (end + 7) / 8; ++word) {
+		uint64_t value;
+		memcpy(&value, memory + 8 * word, sizeof(value));
+		hash ^= WordKey(word, value);
+	}
+	return hash;
+}
+
+static uint64_t HashMemory(const uint8_t* memory, unsigned int size) {
+	uint64_t hash = 0;
+	for (unsigned int word = 0; word < size / 8; ++word) {
+		uint64_t value;
+		memcpy(&value, memory + 8 * word, sizeof(value));
+		if (value) {
+			hash ^= WordKey(word, value) ^ WordKey(word, 0);
+		}
+	}
+	return hash;
+}
+
+// one more word into a hash of a few words
+static uint64_t MixWord(uint64_t hash, uint64_t word) {
+	hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+	return hash ^ (hash >> 32u);
+}
 
 // constructor
-Chip8::Chip8() : randGen(std::chrono::system_clock::now().time_since_epoch().count()) {
+template <unsigned int MemorySize, typename Quirks>
+BasicChip8<MemorySize, Quirks>::BasicChip8() {
 	// initialize random random num generator
-	randByte = std::uniform_int_distribution<uint16_t>(0, 255U);
+	Seed(static_cast<unsigned int>(std::chrono::system_clock::now().time_since_epoch().count()));
+
+	// Dxyn reads the display hash keys without checking
+	DisplayHashKeys();
 
 	// copy font data to memory
 	pc = START_ADDRESS;
-	memcpy(memory + START_ADDRESS, fontset, FONTSET_SIZE * sizeof(fontset[0]));
-
-	// set up function pointer table
-	table[0x0] = &Chip8::Table0;
-	table[0x1] = &Chip8::OP_1nnn;
-	table[0x2] = &Chip8::OP_2nnn;
-	table[0x3] = &Chip8::OP_3xkk;
-	table[0x4] = &Chip8::OP_4xkk;
-	table[0x5] = &Chip8::OP_5xy0;
-	table[0x6] = &Chip8::OP_6xkk;
-	table[0x7] = &Chip8::OP_7xkk;
-	table[0x8] = &Chip8::Table8;
-	table[0x9] = &Chip8::OP_9xy0;
-	table[0xA] = &Chip8::OP_Annn;
-	table[0xB] = &Chip8::OP_Bnnn;
-	table[0xC] = &Chip8::OP_Cxkk;
-	table[0xD] = &Chip8::OP_Dxyn;
-	table[0xE] = &Chip8::TableE;
-	table[0xF] = &Chip8::TableF;
-
-	for (size_t i = 0; i <= 0xE; i++) {
-		table0[i] = &Chip8::OP_NULL;
-		table8[i] = &Chip8::OP_NULL;
-		tableE[i] = &Chip8::OP_NULL;
-	}
-
-	table[0x0] = &Chip8::OP_00E0;
-	table[0xE] = &Chip8::OP_00EE;
-
-	table8[0x0] = &Chip8::OP_8xy0;
-	table8[0x1] = &Chip8::OP_8xy1;
-	table8[0x2] = &Chip8::OP_8xy2;
-	table8[0x3] = &Chip8::OP_8xy3;
-	table8[0x4] = &Chip8::OP_8xy4;
-	table8[0x5] = &Chip8::OP_8xy5;
-	table8[0x6] = &Chip8::OP_8xy6;
-	table8[0x7] = &Chip8::OP_8xy7;
-	table8[0xE] = &Chip8::OP_8xyE;
-
-	tableE[0x1] = &Chip8::OP_ExA1;
-	tableE[0xE] = &Chip8::OP_Ex9E;
-
-	for (size_t i = 0; i <= 0x65; i++)
-	{
-		tableF[i] = &Chip8::OP_NULL;
+	memcpy(memory + FONTSET_START_ADDRESS, fontset, FONTSET_SIZE * sizeof(fontset[0]));
+	memcpy(memory + BIG_FONTSET_START_ADDRESS, bigFontset, BIG_FONTSET_SIZE * sizeof(bigFontset[0]));
+
+	// every machine starts with the same fonts below START_ADDRESS
+	static const uint64_t fontHash = HashMemory(memory, START_ADDRESS);
+	memoryHash = fontHash;
+}
+
+template <unsigned int MemorySize, typename Quirks>
+constexpr typename BasicChip8<MemorySize, Quirks>::Chip8Func BasicChip8<MemorySize, Quirks>::HandlerFunction(OpcodeHandler handler) {
+	switch (handler) {
+		case HANDLER_00E0: return &BasicChip8::OP_00E0;
+		case HANDLER_00EE: return &BasicChip8::OP_00EE;
+		case HANDLER_1nnn: return &BasicChip8::OP_1nnn;
+		case HANDLER_2nnn: return &BasicChip8::OP_2nnn;
+		case HANDLER_3xkk: return &BasicChip8::OP_3xkk;
+		case HANDLER_4xkk: return &BasicChip8::OP_4xkk;
+		case HANDLER_5xy0: return &BasicChip8::OP_5xy0;
+		case HANDLER_6xkk: return &BasicChip8::OP_6xkk;
+		case HANDLER_7xkk: return &BasicChip8::OP_7xkk;
+		case HANDLER_8xy0: return &BasicChip8::OP_8xy0;
+		case HANDLER_8xy1: return &BasicChip8::OP_8xy1;
+		case HANDLER_8xy2: return &BasicChip8::OP_8xy2;
+		case HANDLER_8xy3: return &BasicChip8::OP_8xy3;
+		case HANDLER_8xy4: return &BasicChip8::OP_8xy4;
+		case HANDLER_8xy5: return &BasicChip8::OP_8xy5;
+		case HANDLER_8xy6: return &BasicChip8::OP_8xy6;
+		case HANDLER_8xy7: return &BasicChip8::OP_8xy7;
+		case HANDLER_8xyE: return &BasicChip8::OP_8xyE;
+		case HANDLER_9xy0: return &BasicChip8::OP_9xy0;
+		case HANDLER_Annn: return &BasicChip8::OP_Annn;
+		case HANDLER_Bnnn: return &BasicChip8::OP_Bnnn;
+		case HANDLER_Cxkk: return &BasicChip8::OP_Cxkk;
+		case HANDLER_Dxyn: return &BasicChip8::OP_Dxyn;
+		case HANDLER_Ex9E: return &BasicChip8::OP_Ex9E;
+		case HANDLER_ExA1: return &BasicChip8::OP_ExA1;
+		case HANDLER_Fx07: return &BasicChip8::OP_Fx07;
+		case HANDLER_Fx0A: return &BasicChip8::OP_Fx0A;
+		case HANDLER_Fx15: return &BasicChip8::OP_Fx15;
+		case HANDLER_Fx18: return &BasicChip8::OP_Fx18;
+		case HANDLER_Fx1E: return &BasicChip8::OP_Fx1E;
+		case HANDLER_Fx29: return &BasicChip8::OP_Fx29;
+		case HANDLER_Fx33: return &BasicChip8::OP_Fx33;
+		case HANDLER_Fx55: return &BasicChip8::OP_Fx55;
+		case HANDLER_Fx65: return &BasicChip8::OP_Fx65;
+		case HANDLER_00Cn: return &BasicChip8::OP_00Cn;
+		case HANDLER_00FB: return &BasicChip8::OP_00FB;
+		case HANDLER_00FC: return &BasicChip8::OP_00FC;
+		case HANDLER_00FD: return &BasicChip8::OP_00FD;
+		case HANDLER_00FE: return &BasicChip8::OP_00FE;
+		case HANDLER_00FF: return &BasicChip8::OP_00FF;
+		case HANDLER_Fx30: return &BasicChip8::OP_Fx30;
+		case HANDLER_Fx75: return &BasicChip8::OP_Fx75;
+		case HANDLER_Fx85: return &BasicChip8::OP_Fx85;
+		case HANDLER_5xy2: return &BasicChip8::OP_5xy2;
+		case HANDLER_5xy3: return &BasicChip8::OP_5xy3;
+		case HANDLER_F000: return &BasicChip8::OP_F000;
+		case HANDLER_Fn01: return &BasicChip8::OP_Fn01;
+		case HANDLER_F002: return &BasicChip8::OP_F002;
+		case HANDLER_Fx3A: return &BasicChip8::OP_Fx3A;
+		default: return &BasicChip8::OP_NULL;
 	}
+}
+
+// function pointer tables, built at compile time from DecodeHandler so the
+// profiler, disassembler and analyzer decode exactly what the core runs
+template <unsigned int MemorySize, typename Quirks>
+constexpr typename BasicChip8<MemorySize, Quirks>::Dispatch BasicChip8<MemorySize, Quirks>::MakeDispatch() {
+	// a handler added to opcodes.h needs its member function in HandlerFunction
+	static_assert([]() {
+		for (unsigned int handler = HANDLER_NULL + 1; handler < HANDLER_COUNT; ++handler) {
+			if (HandlerFunction(static_cast<OpcodeHandler>(handler)) == &BasicChip8::OP_NULL) {
+				return false;
+			}
+		}
+		return true;
+	}(), "every OpcodeHandler runs a member function");
+
+	Dispatch tables;
 
-	tableF[0x07] = &Chip8::OP_Fx07;
-	tableF[0x0A] = &Chip8::OP_Fx0A;
-	tableF[0x15] = &Chip8::OP_Fx15;
-	tableF[0x18] = &Chip8::OP_Fx18;
-	tableF[0x1E] = &Chip8::OP_Fx1E;
-	tableF[0x29] = &Chip8::OP_Fx29;
-	tableF[0x33] = &Chip8::OP_Fx33;
-	tableF[0x55] = &Chip8::OP_Fx55;
-	tableF[0x65] = &Chip8::OP_Fx65;
+	for (unsigned int i = 0; i <= 0xF; i++) {
+		tables.table[i] = HandlerFunction(DecodeHandler(static_cast<uint16_t>(i << 12u), XO));
+		tables.table5[i] = HandlerFunction(DecodeHandler(static_cast<uint16_t>(0x5000u | i), XO));
+		tables.table8[i] = HandlerFunction(DecodeHandler(static_cast<uint16_t>(0x8000u | i), XO));
+		tables.tableE[i] = HandlerFunction(DecodeHandler(static_cast<uint16_t>(0xE000u | i), XO));
+	}
+
+	for (unsigned int i = 0; i <= 0xFF; i++) {
+		tables.table0[i] = HandlerFunction(DecodeHandler(static_cast<uint16_t>(i), XO));
+		tables.tableF[i] = HandlerFunction(DecodeHandler(static_cast<uint16_t>(0xF000u | i), XO));
+	}
+
+	// groups decoded on more than the first nibble go through a second table
+	tables.table[0x0] = &BasicChip8::Table0;
+	tables.table[0x8] = &BasicChip8::Table8;
+	tables.table[0xE] = &BasicChip8::TableE;
+	tables.table[0xF] = &BasicChip8::TableF;
+	if constexpr (XO) {
+		tables.table[0x5] = &BasicChip8::Table5;
+	}
+
+	return tables;
 }
 
+template <unsigned int MemorySize, typename Quirks>
+constinit const typename BasicChip8<MemorySize, Quirks>::Dispatch BasicChip8<MemorySize, Quirks>::dispatch = MakeDispatch();
+
 // function invocation
-void Chip8::Table0()
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Table0()
 {
-	((*this).*(table0[opcode & 0x000Fu]))();
+	((*this).*(dispatch.table0[opcode & 0x00FFu]))();
 }
 
-void Chip8::Table8()
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Table5()
 {
-	((*this).*(table8[opcode & 0x000Fu]))();
+	((*this).*(dispatch.table5[opcode & 0x000Fu]))();
 }
 
-void Chip8::TableE()
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Table8()
 {
-	((*this).*(tableE[opcode & 0x000Fu]))();
+	((*this).*(dispatch.table8[opcode & 0x000Fu]))();
 }
 
-void Chip8::TableF()
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::TableE()
 {
-	((*this).*(tableF[opcode & 0x00FFu]))();
+	((*this).*(dispatch.tableE[opcode & 0x000Fu]))();
 }
 
-void Chip8::OP_NULL()
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::TableF()
+{
+	((*this).*(dispatch.tableF[opcode & 0x00FFu]))();
+}
+
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_NULL()
 {}
 
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::SkipNext() {
+	if constexpr (XO) {
+		if (memory[pc & MEMORY_MASK] == 0xF0 && memory[(pc + 1) & MEMORY_MASK] == 0x00) {
+			pc += 2;
+		}
+	}
+	pc += 2;
+}
+
 	
 // Instructions
 
+// 00Cn: SCD nibble
+// scroll the display down n lines
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00Cn() {
+	unsigned int lines = opcode & 0x000Fu;
+	unsigned int height = VideoHeight();
+
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		if (planeMask & (1u << plane)) {
+			memmove(video[plane][lines], video[plane][0], (height - lines) * sizeof(video[plane][0]));
+			memset(video[plane][0], 0, lines * sizeof(video[plane][0]));
+			planeHash[plane] = HashPlane(video[plane], plane, VideoHeight(), VideoWidth() / 64);
+		}
+	}
+}
+
 // 00E0: CLS
 // clear the display
-void Chip8::OP_00E0() {
-	memset(video, 0, sizeof(video));
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00E0() {
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		if (planeMask & (1u << plane)) {
+			memset(video[plane], 0, sizeof(video[plane]));
+			planeHash[plane] = 0;
+		}
+	}
 }
 
 // 00EE: RET
 // return from a subroutine
-void Chip8::OP_00EE() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00EE() {
 	--sp;
-	pc = stack[sp];
+	pc = stack[sp & 0xFu];
+}
+
+// 00FB: SCR
+// scroll the display right 4 pixels
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00FB() {
+	unsigned int words = VideoWidth() / 64;
+
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		if (!(planeMask & (1u << plane))) {
+			continue;
+		}
+		for (unsigned int row = 0; row < VideoHeight(); ++row) {
+			uint64_t* line = video[plane][row];
+			for (unsigned int word = words - 1; word > 0; --word) {
+				line[word] = (line[word] >> 4u) | (line[word - 1] << 60u);
+			}
+			line[0] >>= 4u;
+		}
+		planeHash[plane] = HashPlane(video[plane], plane, VideoHeight(), VideoWidth() / 64);
+	}
+}
+
+// 00FC: SCL
+// scroll the display left 4 pixels
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00FC() {
+	unsigned int words = VideoWidth() / 64;
+
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		if (!(planeMask & (1u << plane))) {
+			continue;
+		}
+		for (unsigned int row = 0; row < VideoHeight(); ++row) {
+			uint64_t* line = video[plane][row];
+			for (unsigned int word = 0; word + 1 < words; ++word) {
+				line[word] = (line[word] << 4u) | (line[word + 1] >> 60u);
+			}
+			line[words - 1] <<= 4u;
+		}
+		planeHash[plane] = HashPlane(video[plane], plane, VideoHeight(), VideoWidth() / 64);
+	}
+}
+
+// 00FD: EXIT
+// stop the interpreter: the machine stays on this instruction
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00FD() {
+	pc -= 2;
+}
+
+// 00FE: LOW
+// switch to the 64x32 display and clear it
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00FE() {
+	hires = false;
+	memset(video, 0, sizeof(video));
+	memset(planeHash, 0, sizeof(planeHash));
+}
+
+// 00FF: HIGH
+// switch to the 128x64 display and clear it
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_00FF() {
+	hires = true;
+	memset(video, 0, sizeof(video));
+	memset(planeHash, 0, sizeof(planeHash));
 }
 
 // 1nnn: JP addr
 // jump to location nnn
-void Chip8::OP_1nnn() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_1nnn() {
 	uint16_t address = opcode & 0x0FFFu;
 
 	pc = address;
@@ -138,50 +438,89 @@ void Chip8::OP_1nnn() {
 
 // 2nn: CALL addr
 // call subroutine at nnn
-void Chip8::OP_2nnn() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_2nnn() {
 	uint16_t address = opcode & 0x0FFFu;
 
-	stack[sp] = pc;
+	stack[sp & 0xFu] = pc;
 	++sp;
 	pc = address;
 }
 
 // 3xkk: SE Vx, byte
 // skip next instruction if Vx = kk
-void Chip8::OP_3xkk() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_3xkk() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t byte = opcode & 0x00FFu;
 
 	if (registers[Vx] == byte) {
-		pc += 2;
+		SkipNext();
 	}
 }
 
 // 4xkk: SE Vx, byte
 // skip next instruction if Vx != kk
-void Chip8::OP_4xkk() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_4xkk() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t byte = opcode & 0x00FFu;
 
 	if (registers[Vx] != byte) {
-		pc += 2;
+		SkipNext();
 	}
 }
 
 // 5xy0: SE Vx, Vy
 // skip next instruction if Vx = Vy
-void Chip8::OP_5xy0() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_5xy0() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
 	if (registers[Vx] == registers[Vy]) {
-		pc += 2;
+		SkipNext();
+	}
+}
+
+// 5xy2: LD [I], Vx-Vy
+// store registers Vx through Vy in memory starting at location I, either direction; I is unchanged
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_5xy2() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+	int step = Vx <= Vy ? 1 : -1;
+
+	for (unsigned int i = 0; ; ++i) {
+		uint8_t reg = static_cast<uint8_t>(Vx + step * static_cast<int>(i));
+		Store(index + i, registers[reg]);
+		if (reg == Vy) {
+			break;
+		}
+	}
+}
+
+// 5xy3: LD Vx-Vy, [I]
+// read registers Vx through Vy from memory starting at location I, either direction; I is unchanged
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_5xy3() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+	int step = Vx <= Vy ? 1 : -1;
+
+	for (unsigned int i = 0; ; ++i) {
+		uint8_t reg = static_cast<uint8_t>(Vx + step * static_cast<int>(i));
+		registers[reg] = memory[(index + i) & MEMORY_MASK];
+		if (reg == Vy) {
+			break;
+		}
 	}
 }
 
 // 6xkk: LD Vx, byte
 // set Vx = kk
-void Chip8::OP_6xkk() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_6xkk() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t byte = opcode & 0x00FFU;
 
@@ -190,7 +529,8 @@ void Chip8::OP_6xkk() {
 
 // 7xkk: ADD Vx, byte
 // set Vx = Vx + kk
-void Chip8::OP_7xkk() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_7xkk() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t byte = opcode & 0x00FFU;
 
@@ -199,7 +539,8 @@ void Chip8::OP_7xkk() {
 
 // 8xkk: LD Vx, Vy
 // set Vx = Vy
-void Chip8::OP_8xy0() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy0() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
@@ -208,34 +549,50 @@ void Chip8::OP_8xy0() {
 
 // 8xy1: OR Vx, Vy
 // set Vx = Vx OR Vy
-void Chip8::OP_8xy1() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy1() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
 	registers[Vx] |= registers[Vy];
+
+	if constexpr (Quirks::logicResetsVF) {
+		registers[0xF] = 0;
+	}
 }
 
 // 8xy2: AND Vx, Vy
 // set Vx = Vx AND Vy
-void Chip8::OP_8xy2() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy2() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
 	registers[Vx] &= registers[Vy];
+
+	if constexpr (Quirks::logicResetsVF) {
+		registers[0xF] = 0;
+	}
 }
 
 // 8xy2: XOR Vx, Vy
 // set Vx = Vx XOR Vy
-void Chip8::OP_8xy3() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy3() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
 	registers[Vx] ^= registers[Vy];
+
+	if constexpr (Quirks::logicResetsVF) {
+		registers[0xF] = 0;
+	}
 }
 
 // 8xy4: ADD Vx, Vy
 // set Vx = Vx + Vy, set VF = carry
-void Chip8::OP_8xy4() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy4() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
@@ -247,7 +604,8 @@ void Chip8::OP_8xy4() {
 
 // 8xy5: SUB Vx, Vy
 // set Vx = Vx - Vy, set VF = NOT borrow
-void Chip8::OP_8xy5() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy5() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
@@ -255,20 +613,24 @@ void Chip8::OP_8xy5() {
 	registers[Vx] -= registers[Vy];
 }
 
-// 8xy6: SHR Vx
-// set Vx = Vx SHR 1  
-void Chip8::OP_8xy6()
+// 8xy6: SHR Vx {, Vy}
+// set Vx = Vx SHR 1 (Vy SHR 1 with Quirks::shiftVy), set VF = the bit shifted out
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy6()
 {
-	uint8_t Vx = (opcode & 0x0F000u) >> 8u;
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+	uint8_t value = Quirks::shiftVy ? registers[Vy] : registers[Vx];
 
-	registers[0xF] = (registers[Vx] & 0x1u);
+	registers[0xF] = value & 0x1u;
 
-	registers[Vx] >>= 1;
+	registers[Vx] = value >> 1;
 }
 
 // 8xy7: SUBN Vx, Vy
 // set Vx = Vy - Vx, set VF = Not borrow
-void Chip8::OP_8xy7() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xy7() {
 	uint8_t Vx = (opcode & 0x0F00) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0) >> 4u;
 
@@ -277,109 +639,191 @@ void Chip8::OP_8xy7() {
 }
 
 // 8xyE: SHL Vx {, Vy}
-// set Vx = Vx SHL 1
-void Chip8::OP_8xyE() {
-	uint8_t Vx = (opcode & 0x0F00) >> 8u;
+// set Vx = Vx SHL 1 (Vy SHL 1 with Quirks::shiftVy), set VF = the bit shifted out
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_8xyE() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+	uint8_t value = Quirks::shiftVy ? registers[Vy] : registers[Vx];
 
-	registers[0xF] = (registers[Vx] & 0x8u);
+	registers[0xF] = value >> 7u;
 
-	registers[Vx] <<= 1;
+	registers[Vx] = static_cast<uint8_t>(value << 1);
 }
 
 // 9xy0: SNE Vx, Vy
 // skip next instruction if Vx != Vy
-void Chip8::OP_9xy0() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_9xy0() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
 	if (registers[Vx] != registers[Vy]) {
-		pc += 2;
+		SkipNext();
 	}
 }
 
 // Annn: LD I, addr
 // set I = nnn
-void Chip8::OP_Annn() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Annn() {
 	uint16_t address = opcode & 0x0FFFu;
 
 	index = address;
 }
 
 // Bnnn: JP V0, addr
-// jump to location nnn + V0
-void Chip8::OP_Bnnn() {
+// jump to location nnn + V0, or xnn + Vx with Quirks::jumpVx
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Bnnn() {
 	uint16_t address = opcode & 0x0FFFu;
+	uint8_t reg = Quirks::jumpVx ? (opcode & 0x0F00u) >> 8u : 0;
 
-	pc = registers[0] + address;
+	pc = registers[reg] + address;
 }
 
 // Cxkk: RND Vx, byte
 // set Vx = random byte AND kk
-void Chip8::OP_Cxkk() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Cxkk() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t byte = opcode & 0x00FFu;
 
-	registers[Vx] = static_cast<uint8_t>(randByte(randGen) & 0x00FF) & byte;
+	registers[Vx] = RandomByte() & byte;
 }
 
 // Dxyn: DRW Vx, Vy, nibble
-// display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision
-void Chip8::OP_Dxyn() {
+// display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision;
+// Dxy0 draws a 16x16 sprite of 2-byte rows. With both XO-CHIP planes
+// selected the second plane's sprite follows the first's in memory.
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Dxyn() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 	uint8_t height = opcode & 0x000Fu;
 
-	uint8_t xPos = registers[Vx] % VIDEO_WIDTH;
-	uint8_t yPos = registers[Vy] % VIDEO_HEIGHT;
+	unsigned int xPos = registers[Vx] % VideoWidth();
+	unsigned int yPos = registers[Vy] % VideoHeight();
 
-	registers[0xF] = 0;
+	unsigned int rows = height ? height : 16;
 
-	for (unsigned int row = 0; row < height; ++row) {
-		uint8_t spriteByte = memory[index + row];
-		for (unsigned int col = 0; col < 8; ++col) {
-			uint8_t spritePixel = spriteByte & (0x80u >> col);
-			uint32_t* screenPixel = &video[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
-
-			if (spritePixel) {
-				if (*screenPixel == 0xFFFFFFFF) {
-					registers[0xF] = 1;
-				}
+	registers[0xF] = 0;
 
-				*screenPixel ^= 0xFFFFFFFF;
+	uint16_t address = index;
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		if (planeMask & (1u << plane)) {
+			bool collision = height ? DrawPlane<8>(plane, address, xPos, yPos, rows) : DrawPlane<16>(plane, address, xPos, yPos, rows);
+			if (collision) {
+				registers[0xF] = 1;
 			}
+			address += static_cast<uint16_t>(height ? rows : 2 * rows);
 		}
 	}
 }
 
+template <unsigned int MemorySize, typename Quirks>
+template <unsigned int SpriteWidth>
+bool BasicChip8<MemorySize, Quirks>::DrawPlane(unsigned int plane, uint16_t address, unsigned int xPos, unsigned int yPos, unsigned int rows) {
+	unsigned int screenHeight = VideoHeight();
+	unsigned int words = VideoWidth() / 64;
+
+	// a sprite row spans at most two words; anything past the last word of
+	// the row is clipped, or wraps to the first with Quirks::wrapSprites
+	unsigned int word = xPos / 64;
+	unsigned int shift = xPos % 64;
+	bool spills = shift + SpriteWidth > 64 && (Quirks::wrapSprites || word + 1 < words);
+	unsigned int next = word + 1 < words ? word + 1 : 0;
+	bool collision = false;
+
+	// the first nibble a sprite row can touch in each word, for the display hash
+	unsigned int firstNibble = shift + SpriteWidth < 64 ? (64 - shift - SpriteWidth) / 4 : 0;
+	unsigned int nextNibble = (128 - shift - SpriteWidth) / 4;
+	uint64_t hash = 0;
+
+	// sprites are clipped at the right and bottom edges unless they wrap
+	for (unsigned int row = 0; row < rows && (Quirks::wrapSprites || yPos + row < screenHeight); ++row) {
+		uint64_t spriteRow = SpriteWidth == 8
+			? memory[(address + row) & MEMORY_MASK]
+			: (memory[(address + 2 * row) & MEMORY_MASK] << 8u) | memory[(address + 2 * row + 1) & MEMORY_MASK];
+		uint64_t bits = spriteRow << (64 - SpriteWidth);	// leftmost sprite pixel in the MSB
+		unsigned int y = Quirks::wrapSprites ? (yPos + row) % screenHeight : yPos + row;
+		uint64_t* line = video[plane][y];
+		const uint64_t (*rowKeys)[16] = displayKeys.key[plane][y];
+
+		// every set bit of the mask flips a pixel
+		uint64_t mask = bits >> shift;
+		collision |= (line[word] & mask) != 0;
+		line[word] ^= mask;
+		hash ^= HashSpriteRow<SpriteWidth / 4 + 1>(rowKeys + word * 16, mask, firstNibble);
+
+		if (spills) {
+			mask = bits << (64 - shift);
+			collision |= (line[next] & mask) != 0;
+			line[next] ^= mask;
+			hash ^= HashSpriteRow<SpriteWidth / 4 + 1>(rowKeys + next * 16, mask, nextNibble);
+		}
+	}
+
+	planeHash[plane] ^= hash;
+	return collision;
+}
+
 // Ex9E: SKP Vx
 // skip next instruction if key with the value of Vx is pressed
-void Chip8::OP_Ex9E() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Ex9E() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	uint8_t key = registers[Vx];
+	uint8_t key = registers[Vx] & 0xFu;
 
-	if (keypad[key])
+	if (keypad & (1u << key))
 	{
-		pc += 2;
+		SkipNext();
 	}
 }
 
 // ExA1: SKNP Vx
 // skip next instruction if key with the value of Vx is not pressed
-void Chip8::OP_ExA1() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_ExA1() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	uint8_t key = registers[Vx];
+	uint8_t key = registers[Vx] & 0xFu;
 
-	if (!keypad[key])
+	if (!(keypad & (1u << key)))
 	{
-		pc += 2;
+		SkipNext();
+	}
+}
+
+// F000 nnnn: LD I, long addr
+// set I = the 16-bit address in the next two bytes
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_F000() {
+	index = static_cast<uint16_t>((memory[pc & MEMORY_MASK] << 8u) | memory[(pc + 1) & MEMORY_MASK]);
+	pc += 2;
+}
+
+// Fn01: PLANE n
+// select the display planes drawn, cleared and scrolled, bit 0 for the first
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fn01() {
+	planeMask = (opcode & 0x0300u) >> 8u;
+}
+
+// F002: AUDIO
+// load the 16-byte audio pattern from memory location I
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_F002() {
+	for (unsigned int i = 0; i < sizeof(audioPattern); ++i) {
+		audioPattern[i] = memory[(index + i) & MEMORY_MASK];
 	}
 }
 
 // Fx07: LD Vx, DT
 // set Vx = delay timer value
-void Chip8::OP_Fx07() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx07() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
 	registers[Vx] = delayTimer;
@@ -387,22 +831,25 @@ void Chip8::OP_Fx07() {
 
 // Fx0A: LD Vx, k
 // wait for a key press, store the value of the key in Vx
-void Chip8::OP_Fx0A() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx0A() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	for (int i = 0; i < 16; ++i) {
-		if (keypad[i]) {
-			registers[Vx] = i;
-			return;
-		}
+	// lowest held key wins
+	if (keypad) {
+		registers[Vx] = static_cast<uint8_t>(std::countr_zero(keypad));
+		waitingForKey = false;
+		return;
 	}
 
+	waitingForKey = true;
 	pc -= 2;
 }
 
 // Fx15: LD DT, Vx
 // set delay timer = Vx
-void Chip8::OP_Fx15() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx15() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
 	delayTimer = registers[Vx];
@@ -410,7 +857,8 @@ void Chip8::OP_Fx15() {
 
 // Fx18: LD ST, Vx
 // set sound timer = Vx
-void Chip8::OP_Fx18() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx18() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
 	soundTimer = registers[Vx];
@@ -418,7 +866,8 @@ void Chip8::OP_Fx18() {
 
 // Fx1E: ADD I, Vx
 // set I = I + Vx
-void Chip8::OP_Fx1E() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx1E() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
 	index += registers[Vx];
@@ -426,89 +875,364 @@ void Chip8::OP_Fx1E() {
 
 // Fx29: LD F, Vx
 // set I = location of sprite for digit Vx
-void Chip8::OP_Fx29() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx29() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t digit = registers[Vx];
 
 	index = FONTSET_START_ADDRESS + (5 * digit);
 }
 
+// Fx30: LD HF, Vx
+// set I = location of the 8x10 sprite for digit Vx
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx30() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+	uint8_t digit = registers[Vx] & 0xFu;
+
+	index = BIG_FONTSET_START_ADDRESS + (10 * digit);
+}
+
 // Fx33: LD B, Vx
 // store BCD representation of Vx in memory location I, I+1 ,and I+2
-void Chip8::OP_Fx33() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx33() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t value = registers[Vx];
 
-	memory[index + 2] = value % 10;
-	value /= 10;
+	uint8_t digits[3] = { static_cast<uint8_t>(value / 100), static_cast<uint8_t>(value / 10 % 10), static_cast<uint8_t>(value % 10) };
+
+	// the three bytes share one or two words of the memory hash
+	if (index + 2u < MemorySize) {
+		memoryHash ^= HashWords(memory, index, index + 3u);
+		memcpy(memory + index, digits, sizeof(digits));
+		memoryHash ^= HashWords(memory, index, index + 3u);
+	}
+	else {
+		for (unsigned int i = 0; i < 3; ++i) {
+			Store(index + i, digits[i]);
+		}
+	}
+}
 
-	memory[index + 1] = value % 10;
-	value /= 10;
+// Fx3A: PITCH Vx
+// set the audio playback pitch = Vx
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx3A() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	memory[index] = value % 10;
+	pitch = registers[Vx];
 }
 
 // Fx55: LD [I], Vx
 // store registers V0 through Vx in memory starting at location I
-void Chip8::OP_Fx55() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx55() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	for (uint8_t i = 0; i <= Vx; ++i) {
-		memory[index + i] = registers[i];
+	// only a block at the very end of memory wraps
+	if (index + Vx < MemorySize) {
+		memoryHash ^= HashWords(memory, index, index + Vx + 1);
+		memcpy(memory + index, registers, Vx + 1);
+		memoryHash ^= HashWords(memory, index, index + Vx + 1);
+	}
+	else {
+		for (uint8_t i = 0; i <= Vx; ++i) {
+			Store(index + i, registers[i]);
+		}
+	}
+
+	if constexpr (Quirks::loadStoreIndex) {
+		index += Vx + 1;
 	}
 }
 
 // Fx65: LD Vx, [i]
 // read registers V0 through Vx from memory starting at location I
-void Chip8::OP_Fx65() {
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx65() {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	for (uint8_t i = 0; i <= Vx; ++i) {
-		registers[i] = memory[index + i];
+	if (index + Vx < MemorySize) {
+		memcpy(registers, memory + index, Vx + 1);
+	}
+	else {
+		for (uint8_t i = 0; i <= Vx; ++i) {
+			registers[i] = memory[(index + i) & MEMORY_MASK];
+		}
+	}
+
+	if constexpr (Quirks::loadStoreIndex) {
+		index += Vx + 1;
 	}
 }
 
-// load ROM file
-void Chip8::LoadROM(char const* filename) {
+// Fx75: LD R, Vx
+// store registers V0 through Vx in the user flags
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx75() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+	memcpy(rplFlags, registers, Vx + 1);
+}
+
+// Fx85: LD Vx, R
+// read registers V0 through Vx from the user flags
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::OP_Fx85() {
+	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
+
+	memcpy(registers, rplFlags, Vx + 1);
+}
 
+const char* LoadResultMessage(LoadResult result) {
+	switch (result) {
+		case LoadResult::Ok: return "ok";
+		case LoadResult::FileNotFound: return "file not found";
+		case LoadResult::TooLarge: return "ROM does not fit in memory";
+		case LoadResult::ReadError: return "read error";
+	}
+	return "unknown error";
+}
+
+// load ROM file
+template <unsigned int MemorySize, typename Quirks>
+LoadResult BasicChip8<MemorySize, Quirks>::LoadROM(char const* filename) {
 	std::ifstream file(filename, std::ios::binary | std::ios::ate);  // open file, go to end
 
-	if (file.is_open()) {
-		std::streampos size = file.tellg();		// get size
-		char* buffer = new char[size];			// create buffer
+	if (!file.is_open()) {
+		return LoadResult::FileNotFound;
+	}
 
-		file.seekg(0, std::ios::beg);	// go to beginning
-		file.read(buffer, size);		// copy file to buffer
-		file.close();					// close file
+	std::streamoff size = file.tellg();		// get size
 
-		std::memcpy(memory + START_ADDRESS, buffer, size * sizeof(buffer[0]));  // copy to chip8 memory
+	if (size < 0) {
+		return LoadResult::ReadError;
+	}
 
-		delete[] buffer;	// clear buffer
+	if (size > static_cast<std::streamoff>(MAX_ROM)) {
+		return LoadResult::TooLarge;
 	}
+
+	file.seekg(0, std::ios::beg);	// go to beginning
+	memoryHash ^= HashWords(memory, START_ADDRESS, START_ADDRESS + static_cast<unsigned int>(size));
+	file.read(reinterpret_cast<char*>(memory + START_ADDRESS), size);	// read into chip8 memory
+	memoryHash ^= HashWords(memory, START_ADDRESS, START_ADDRESS + static_cast<unsigned int>(size));
+
+	if (file.gcount() != size) {
+		return LoadResult::ReadError;
+	}
+
+	return LoadResult::Ok;
 }
 
+// load ROM from memory, e.g. a shared ROM cache
+template <unsigned int MemorySize, typename Quirks>
+LoadResult BasicChip8<MemorySize, Quirks>::LoadROM(std::span<const uint8_t> rom) {
+	if (rom.size() > MAX_ROM) {
+		return LoadResult::TooLarge;
+	}
 
-// Fetch, Decode, Execute Cylce
-void Chip8::Cycle() {
-	// fetch
-	opcode = (memory[pc] << 8u) | memory[pc + 1];
+	unsigned int end = START_ADDRESS + static_cast<unsigned int>(rom.size());
+	memoryHash ^= HashWords(memory, START_ADDRESS, end);
+	memcpy(memory + START_ADDRESS, rom.data(), rom.size());
+	memoryHash ^= HashWords(memory, START_ADDRESS, end);
+	return LoadResult::Ok;
+}
 
-	// increment PC
-	pc += 2;
 
-	// decode and execute
-	((*this).*(table[(opcode & 0xF000u) >> 12u]))();  // basically Chip8.function()
+// copy the machine state out
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::SaveState(State& state) const {
+	memcpy(state.registers, registers, sizeof(registers));
+	memcpy(state.memory, memory, sizeof(memory));
+	state.memoryHash = memoryHash;
+	state.index = index;
+	state.pc = pc;
+	memcpy(state.stack, stack, sizeof(stack));
+	state.sp = sp;
+	state.delayTimer = delayTimer;
+	state.soundTimer = soundTimer;
+	state.keypad = keypad;
+	memcpy(state.video, video, sizeof(video));
+	memcpy(state.planeHash, planeHash, sizeof(planeHash));
+	memcpy(state.rplFlags, rplFlags, sizeof(rplFlags));
+	state.hires = hires;
+	state.planeMask = planeMask;
+	state.pitch = pitch;
+	memcpy(state.audioPattern, audioPattern, sizeof(audioPattern));
+	state.randState = randState;
+}
 
-	// decrement the delay timer if it is set
-	if (delayTimer > 0)
-	{
-		--delayTimer;
+// restore the machine state from a snapshot
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::LoadState(const State& state) {
+	memcpy(registers, state.registers, sizeof(registers));
+	memcpy(memory, state.memory, sizeof(memory));
+	memoryHash = state.memoryHash;
+	index = state.index;
+	pc = state.pc;
+	memcpy(stack, state.stack, sizeof(stack));
+	sp = state.sp;
+	delayTimer = state.delayTimer;
+	soundTimer = state.soundTimer;
+	keypad = state.keypad;
+	memcpy(video, state.video, sizeof(video));
+	memcpy(planeHash, state.planeHash, sizeof(planeHash));
+	memcpy(rplFlags, state.rplFlags, sizeof(rplFlags));
+	hires = state.hires;
+	planeMask = state.planeMask;
+	pitch = state.pitch;
+	memcpy(audioPattern, state.audioPattern, sizeof(audioPattern));
+	randState = state.randState ? state.randState : 1;
+	waitingForKey = false;
+}
+
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Seed(unsigned int seed) {
+	// spread small seeds over the state, xorshift must not start at zero
+	randState = seed * 2654435761u + 0x9E3779B9u;
+	if (randState == 0) {
+		randState = 1;
 	}
+}
 
-	// decrement the sound timer if it is set
-	if (soundTimer > 0)
-	{
-		--soundTimer;
+template <unsigned int MemorySize, typename Quirks>
+uint8_t BasicChip8<MemorySize, Quirks>::RandomByte() {
+	randState ^= randState << 13u;
+	randState ^= randState >> 17u;
+	randState ^= randState << 5u;
+	return static_cast<uint8_t>(randState >> 24u);
+}
+
+// one VIDEO_WIDTH pixel row of the low resolution view, leftmost pixel in the MSB
+static uint64_t LowResolutionRow(const uint64_t (*video)[VIDEO_ROW_WORDS], bool hires, unsigned int row) {
+	if (!hires) {
+		return video[row][0];
+	}
+
+	// OR the two source lines and each pair of pixels, then squeeze the pairs to single bits
+	uint64_t result = 0;
+	for (unsigned int word = 0; word < VIDEO_ROW_WORDS; ++word) {
+		uint64_t pairs = video[2 * row][word] | video[2 * row + 1][word];
+		pairs = (pairs | (pairs >> 1u)) & 0x5555555555555555ull;
+		pairs = (pairs | (pairs >> 1u)) & 0x3333333333333333ull;
+		pairs = (pairs | (pairs >> 2u)) & 0x0F0F0F0F0F0F0F0Full;
+		pairs = (pairs | (pairs >> 4u)) & 0x00FF00FF00FF00FFull;
+		pairs = (pairs | (pairs >> 8u)) & 0x0000FFFF0000FFFFull;
+		pairs = (pairs | (pairs >> 16u)) & 0x00000000FFFFFFFFull;
+		result |= pairs << (32 * (VIDEO_ROW_WORDS - 1 - word));
 	}
+	return result;
+}
+
+// 1 bit per pixel, 8 pixels per byte, leftmost pixel in the MSB
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::PackVideo1bpp(uint8_t* out) const {
+	for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row) {
+		uint64_t line = 0;
+		for (unsigned int plane = 0; plane < PLANES; ++plane) {
+			line |= LowResolutionRow(video[plane], hires, row);
+		}
+		for (unsigned int byte = 0; byte < VIDEO_WIDTH / 8; ++byte) {
+			*out++ = static_cast<uint8_t>(line >> (56 - 8 * byte));
+		}
+	}
+}
+
+// 1 byte per pixel, 0 or 1
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::PackVideo8bpp(uint8_t* out) const {
+	for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row) {
+		uint64_t line = 0;
+		for (unsigned int plane = 0; plane < PLANES; ++plane) {
+			line |= LowResolutionRow(video[plane], hires, row);
+		}
+		for (unsigned int col = 0; col < VIDEO_WIDTH; ++col) {
+			*out++ = (line >> (63 - col)) & 1u;
+		}
+	}
+}
+
+template <unsigned int MemorySize, typename Quirks>
+unsigned int BasicChip8<MemorySize, Quirks>::PixelPlanes(unsigned int x, unsigned int y) const {
+	unsigned int planes = 0;
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		planes |= ((video[plane][y][x / 64] >> (63 - x % 64)) & 1u) << plane;
+	}
+	return planes;
+}
+
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::ExpandVideo(uint32_t* out) const {
+	// off, first plane, second plane, both
+	static const uint32_t palette[4] = { 0u, 0xFFFFFFFFu, 0xFFAAAAAAu, 0xFF555555u };
+	unsigned int scale = hires ? 1 : 2;
+
+	for (unsigned int y = 0; y < HIRES_HEIGHT; ++y) {
+		for (unsigned int x = 0; x < HIRES_WIDTH; ++x) {
+			*out++ = palette[PixelPlanes(x / scale, y / scale)];
+		}
+	}
+}
+
+template <unsigned int MemorySize, typename Quirks>
+uint64_t BasicChip8<MemorySize, Quirks>::FrameHash() const {
+	uint64_t hash = hires ? HIRES_KEY : 0;
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		hash ^= planeHash[plane];
+	}
+	return hash;
+}
+
+template <unsigned int MemorySize, typename Quirks>
+uint64_t BasicChip8<MemorySize, Quirks>::StateHash() const {
+	// memory and display are kept up to date, the rest is a few words
+	uint64_t registerWords[2], stackWords[4], flagWords[2];
+	memcpy(registerWords, registers, sizeof(registers));
+	memcpy(stackWords, stack, sizeof(stack));
+	memcpy(flagWords, rplFlags, sizeof(rplFlags));
+
+	uint64_t hash = memoryHash ^ FrameHash();
+	hash = MixWord(hash, registerWords[0]);
+	hash = MixWord(hash, registerWords[1]);
+	hash = MixWord(hash, index | (static_cast<uint64_t>(pc) << 16u) | (static_cast<uint64_t>(sp) << 32u)
+		| (static_cast<uint64_t>(delayTimer) << 40u) | (static_cast<uint64_t>(soundTimer) << 48u)
+		| (static_cast<uint64_t>(planeMask) << 56u) | (static_cast<uint64_t>(hires) << 63u));
+	for (uint64_t word : stackWords) {
+		hash = MixWord(hash, word);
+	}
+	hash = MixWord(hash, flagWords[0]);
+	hash = MixWord(hash, flagWords[1]);
+	return MixWord(hash, randState);
+}
+
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Rehash(State& state) {
+	state.memoryHash = HashMemory(state.memory, MemorySize);
+	for (unsigned int plane = 0; plane < PLANES; ++plane) {
+		state.planeHash[plane] = HashPlane(state.video[plane], plane);
+	}
+}
+
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Store(unsigned int address, uint8_t value) {
+	address &= MEMORY_MASK;
+	memoryHash ^= HashWords(memory, address, address + 1);
+	memory[address] = value;
+	memoryHash ^= HashWords(memory, address, address + 1);
+}
+
+
+// Fetch, Decode, Execute Cylce
+template <unsigned int MemorySize, typename Quirks>
+void BasicChip8<MemorySize, Quirks>::Cycle() {
+	NullProfiler profiler;
+	Cycle(profiler);
+}
+
 
-}
\ No newline at end of file
+template class BasicChip8<MEMORY_SIZE, DefaultQuirks>;
+template class BasicChip8<MEMORY_SIZE, VipQuirks>;
+template class BasicChip8<MEMORY_SIZE, SchipQuirks>;
+template class BasicChip8<XO_MEMORY_SIZE, XoChipQuirks>;
@@ -0,0 +1,399 @@
+#include "debugger.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "disassembler.h"
+#include "timeline.h"
+
+
+const char* StopReasonName(StopReason reason) {
+	switch (reason) {
+		case StopReason::Step: return "step";
+		case StopReason::Frame: return "frame";
+		case StopReason::Breakpoint: return "breakpoint";
+		case StopReason::Watchpoint: return "watchpoint";
+		case StopReason::WaitingForKey: return "waiting for key";
+		case StopReason::Limit: return "limit";
+	}
+	return "unknown";
+}
+
+void Debugger::SetBreakpoint(uint16_t address, bool enabled) {
+	bool& flag = breakpoints[address & 0x0FFFu];
+	if (flag != enabled) {
+		flag = enabled;
+		enabled ? ++breakpointCount : --breakpointCount;
+	}
+}
+
+void Debugger::SetMemoryWatch(uint16_t address, bool enabled) {
+	bool& flag = memoryWatches[address & 0x0FFFu];
+	if (flag != enabled) {
+		flag = enabled;
+		enabled ? ++memoryWatchCount : --memoryWatchCount;
+	}
+}
+
+void Debugger::SetRegisterWatch(uint8_t reg, bool enabled) {
+	if (enabled) {
+		registerWatchMask |= 1u << (reg & 0xFu);
+	}
+	else {
+		registerWatchMask &= ~(1u << (reg & 0xFu));
+	}
+}
+
+void Debugger::ClearAll() {
+	memset(breakpoints, 0, sizeof(breakpoints));
+	memset(memoryWatches, 0, sizeof(memoryWatches));
+	breakpointCount = 0;
+	memoryWatchCount = 0;
+	registerWatchMask = 0;
+}
+
+// only Fx33 and Fx55 write memory
+static unsigned int MemoryWriteLength(uint16_t opcode) {
+	if ((opcode & 0xF0FFu) == 0xF033u) {
+		return 3;
+	}
+	if ((opcode & 0xF0FFu) == 0xF055u) {
+		return ((opcode & 0x0F00u) >> 8u) + 1;
+	}
+	return 0;
+}
+
+void Debugger::Begin(const Chip8& chip8, uint16_t, uint16_t opcode) {
+	if (registerWatchMask) {
+		for (uint8_t r = 0; r < 16; ++r) {
+			registersBefore[r] = chip8.Register(r);
+		}
+	}
+
+	unsigned int length = memoryWatchCount ? MemoryWriteLength(opcode) : 0;
+	if (length) {
+		indexBefore = chip8.Index();
+		for (unsigned int i = 0; i < length; ++i) {
+			memoryBefore[i] = chip8.ReadMemory(static_cast<uint16_t>(indexBefore + i));
+		}
+	}
+}
+
+void Debugger::End(const Chip8& chip8, uint16_t opcode) {
+	for (uint8_t r = 0; r < 16; ++r) {
+		if ((registerWatchMask & (1u << r)) && chip8.Register(r) != registersBefore[r]) {
+			hit = true;
+			hitRegister = true;
+			hitAddress = r;
+			hitOld = registersBefore[r];
+			hitNew = chip8.Register(r);
+			return;
+		}
+	}
+
+	unsigned int length = memoryWatchCount ? MemoryWriteLength(opcode) : 0;
+	for (unsigned int i = 0; i < length; ++i) {
+		uint16_t address = (indexBefore + i) & 0x0FFFu;
+		if (memoryWatches[address] && chip8.ReadMemory(address) != memoryBefore[i]) {
+			hit = true;
+			hitRegister = false;
+			hitAddress = address;
+			hitOld = memoryBefore[i];
+			hitNew = chip8.ReadMemory(address);
+			return;
+		}
+	}
+}
+
+// one engine per combination, the unused checks compile away
+template <bool CheckBreakpoints, bool CheckWatches>
+StopReason Debugger::Execute(Chip8& chip8, uint64_t cycles, bool resume) {
+	for (uint64_t i = 0; i < cycles; ++i) {
+		if constexpr (CheckBreakpoints) {
+			if ((i > 0 || !resume) && breakpoints[chip8.ProgramCounter() & 0x0FFFu]) {
+				return StopReason::Breakpoint;
+			}
+		}
+
+		if constexpr (CheckWatches) {
+			chip8.Cycle(*this);
+		}
+		else {
+			chip8.Cycle();
+		}
+		++executed;
+
+		if constexpr (CheckWatches) {
+			if (hit) {
+				return StopReason::Watchpoint;
+			}
+		}
+
+		if (chip8.WaitingForKey()) {
+			return StopReason::WaitingForKey;
+		}
+	}
+
+	return StopReason::Step;
+}
+
+StopReason Debugger::Run(Chip8& chip8, uint64_t cycles, bool resume) {
+	hit = false;
+
+	bool watches = memoryWatchCount || registerWatchMask;
+	if (watches) {
+		return breakpointCount ? Execute<true, true>(chip8, cycles, resume) : Execute<false, true>(chip8, cycles, resume);
+	}
+	return breakpointCount ? Execute<true, false>(chip8, cycles, resume) : Execute<false, false>(chip8, cycles, resume);
+}
+
+StopReason Debugger::RunFrames(Chip8& chip8, uint64_t frames, unsigned int cyclesPerFrame) {
+	for (uint64_t frame = 0; frame < frames; ++frame) {
+		// after the first frame a breakpoint at the frame boundary must stop, not be stepped over
+		StopReason reason = Run(chip8, cyclesPerFrame, frame == 0);
+		if (reason != StopReason::Step) {
+			return reason;
+		}
+	}
+
+	return StopReason::Frame;
+}
+
+
+// console
+
+static std::string Hex(unsigned int value, int digits) {
+	std::ostringstream text;
+	text << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+	return text.str();
+}
+
+static void PrintLocation(const Chip8& chip8, std::ostream& out) {
+	uint16_t pc = chip8.ProgramCounter();
+	uint16_t opcode = (chip8.ReadMemory(pc) << 8u) | chip8.ReadMemory(pc + 1);
+	out << Hex(pc, 3) << "  " << Hex(opcode, 4).substr(2) << "  " << Disassemble(opcode) << "\n";
+}
+
+static void PrintRegisters(const Chip8& chip8, std::ostream& out) {
+	Chip8State state;
+	chip8.SaveState(state);
+
+	for (unsigned int r = 0; r < 16; ++r) {
+		out << "V" << std::hex << std::uppercase << r << std::dec << "=" << Hex(state.registers[r], 2).substr(2) << (r % 8 == 7 ? "\n" : " ");
+	}
+	out << "I=" << Hex(state.index, 3) << " PC=" << Hex(state.pc, 3) << " SP=" << static_cast<unsigned int>(state.sp)
+		<< " DT=" << static_cast<unsigned int>(state.delayTimer) << " ST=" << static_cast<unsigned int>(state.soundTimer) << "\n";
+
+	out << "stack:";
+	for (unsigned int i = 0; i < state.sp && i < 16; ++i) {
+		out << " " << Hex(state.stack[i], 3);
+	}
+	out << "\n";
+}
+
+static void PrintStop(const Debugger& debugger, StopReason reason, const Chip8& chip8, uint64_t position, std::ostream& out) {
+	out << "[" << StopReasonName(reason);
+	if (reason == StopReason::Watchpoint) {
+		out << " " << (debugger.HitRegister() ? "V" + Hex(debugger.HitAddress(), 1).substr(2) : Hex(debugger.HitAddress(), 3))
+			<< " " << Hex(debugger.HitOld(), 2) << " -> " << Hex(debugger.HitNew(), 2);
+	}
+	out << ", cycle " << position << "] ";
+	PrintLocation(chip8, out);
+}
+
+static bool ParseNumber(const std::string& text, int base, unsigned long& value) {
+	try {
+		size_t used = 0;
+		value = std::stoul(text, &used, base);
+		return used == text.size();
+	}
+	catch (...) {
+		return false;
+	}
+}
+
+// "v3"/"V3" names a register, anything else a hexadecimal address
+static bool ParseTarget(const std::string& text, bool& isRegister, unsigned long& value) {
+	isRegister = text.size() == 2 && (text[0] == 'v' || text[0] == 'V');
+	return ParseNumber(isRegister ? text.substr(1) : text, 16, value) && value < (isRegister ? 16u : 4096u);
+}
+
+static const char* consoleHelp =
+	"break|b <addr>         set a breakpoint (hex)\n"
+	"watch|w <addr|vX>      stop when a memory byte or register changes\n"
+	"delete|d <addr|vX>     remove a breakpoint or watchpoint\n"
+	"list|l                 list breakpoints and watchpoints\n"
+	"step|s [n]             execute n instructions\n"
+	"continue|c [n]         run until a stop, at most n instructions\n"
+	"frame|f [n]            run n frames\n"
+	"rstep|rs [n]           go back n instructions\n"
+	"rcontinue|rc           go back to the previous breakpoint hit\n"
+	"regs|r                 show registers, timers and stack\n"
+	"mem|x <addr> [n]       dump n bytes of memory\n"
+	"dis|u [addr] [n]       disassemble n instructions\n"
+	"key|k <key> <0|1>      release or press a keypad key (hex)\n"
+	"quit|q\n";
+
+int RunDebugConsole(const char* romFilename, unsigned int cyclesPerFrame, std::istream& in, std::ostream& out) {
+	Chip8 chip8;
+	LoadResult loaded = chip8.LoadROM(romFilename);
+	if (loaded != LoadResult::Ok) {
+		out << "Cannot load " << romFilename << ": " << LoadResultMessage(loaded) << "\n";
+		return 1;
+	}
+
+	Debugger debugger;
+	const uint64_t continueLimit = 100000000;
+
+	// every forward command goes through the timeline so it can be reversed
+	Timeline timeline;
+	timeline.Start(chip8);
+
+	PrintLocation(chip8, out);
+
+	std::string line;
+	while (out << "(chip8) " << std::flush, std::getline(in, line)) {
+		std::istringstream words(line);
+		std::string command, first, second;
+		words >> command >> first >> second;
+
+		unsigned long value = 0;
+		unsigned long count = 0;
+		bool isRegister = false;
+
+		if (command.empty()) {
+			continue;
+		}
+		else if (command == "help" || command == "h" || command == "?") {
+			out << consoleHelp;
+		}
+		else if (command == "quit" || command == "q") {
+			break;
+		}
+		else if (command == "break" || command == "b") {
+			if (!ParseTarget(first, isRegister, value) || isRegister) {
+				out << "usage: break <addr>\n";
+				continue;
+			}
+			debugger.SetBreakpoint(static_cast<uint16_t>(value), true);
+		}
+		else if (command == "watch" || command == "w") {
+			if (!ParseTarget(first, isRegister, value)) {
+				out << "usage: watch <addr|vX>\n";
+				continue;
+			}
+			if (isRegister) {
+				debugger.SetRegisterWatch(static_cast<uint8_t>(value), true);
+			}
+			else {
+				debugger.SetMemoryWatch(static_cast<uint16_t>(value), true);
+			}
+		}
+		else if (command == "delete" || command == "d") {
+			if (!ParseTarget(first, isRegister, value)) {
+				out << "usage: delete <addr|vX>\n";
+				continue;
+			}
+			if (isRegister) {
+				debugger.SetRegisterWatch(static_cast<uint8_t>(value), false);
+			}
+			else {
+				debugger.SetBreakpoint(static_cast<uint16_t>(value), false);
+				debugger.SetMemoryWatch(static_cast<uint16_t>(value), false);
+			}
+		}
+		else if (command == "list" || command == "l") {
+			for (unsigned int address = 0; address < 4096; ++address) {
+				if (debugger.Breakpoint(static_cast<uint16_t>(address))) {
+					out << "break " << Hex(address, 3) << "\n";
+				}
+				if (debugger.MemoryWatch(static_cast<uint16_t>(address))) {
+					out << "watch " << Hex(address, 3) << "\n";
+				}
+			}
+			for (uint8_t r = 0; r < 16; ++r) {
+				if (debugger.RegisterWatch(r)) {
+					out << "watch V" << Hex(r, 1).substr(2) << "\n";
+				}
+			}
+		}
+		else if (command == "step" || command == "s" || command == "continue" || command == "c" || command == "frame" || command == "f") {
+			bool frames = command[0] == 'f';
+			count = command[0] == 's' || frames ? 1 : continueLimit;
+			if (!first.empty() && !ParseNumber(first, 10, count)) {
+				out << "usage: " << command << " [n]\n";
+				continue;
+			}
+
+			StopReason reason = frames ? StopReason::Frame : timeline.Run(chip8, debugger, count);
+			for (unsigned long frame = 0; frames && frame < count && reason == StopReason::Frame; ++frame) {
+				// a breakpoint at a frame boundary stops, only the first frame steps over one
+				reason = timeline.Run(chip8, debugger, cyclesPerFrame, frame == 0);
+				reason = reason == StopReason::Step ? StopReason::Frame : reason;
+			}
+			if (command[0] == 'c' && reason == StopReason::Step) {
+				reason = StopReason::Limit;
+			}
+			PrintStop(debugger, reason, chip8, timeline.Position(), out);
+		}
+		else if (command == "rstep" || command == "rs") {
+			count = 1;
+			if (!first.empty() && !ParseNumber(first, 10, count)) {
+				out << "usage: rstep [n]\n";
+				continue;
+			}
+			bool reached = timeline.ReverseStep(chip8, count);
+			PrintStop(debugger, reached ? StopReason::Step : StopReason::Limit, chip8, timeline.Position(), out);
+		}
+		else if (command == "rcontinue" || command == "rc") {
+			StopReason reason = timeline.ReverseContinue(chip8, debugger);
+			PrintStop(debugger, reason, chip8, timeline.Position(), out);
+		}
+		else if (command == "regs" || command == "r") {
+			PrintRegisters(chip8, out);
+		}
+		else if (command == "mem" || command == "x") {
+			count = 16;
+			if (!ParseNumber(first, 16, value) || (!second.empty() && !ParseNumber(second, 10, count))) {
+				out << "usage: mem <addr> [n]\n";
+				continue;
+			}
+			for (unsigned long i = 0; i < count; ++i) {
+				if (i % 16 == 0) {
+					out << (i ? "\n" : "") << Hex((value + i) & 0x0FFFu, 3) << ":";
+				}
+				out << " " << Hex(chip8.ReadMemory(static_cast<uint16_t>(value + i)), 2).substr(2);
+			}
+			out << "\n";
+		}
+		else if (command == "dis" || command == "u") {
+			value = chip8.ProgramCounter();
+			count = 10;
+			if ((!first.empty() && !ParseNumber(first, 16, value)) || (!second.empty() && !ParseNumber(second, 10, count))) {
+				out << "usage: dis [addr] [n]\n";
+				continue;
+			}
+			for (unsigned long i = 0; i < count; ++i) {
+				uint16_t address = (value + 2 * i) & 0x0FFFu;
+				uint16_t opcode = (chip8.ReadMemory(address) << 8u) | chip8.ReadMemory(address + 1);
+				out << (debugger.Breakpoint(address) ? "*" : " ") << (address == chip8.ProgramCounter() ? ">" : " ")
+					<< Hex(address, 3) << "  " << Hex(opcode, 4).substr(2) << "  " << Disassemble(opcode) << "\n";
+			}
+		}
+		else if (command == "key" || command == "k") {
+			if (!ParseNumber(first, 16, value) || value > 0xF || !ParseNumber(second, 10, count)) {
+				out << "usage: key <key> <0|1>\n";
+				continue;
+			}
+			uint16_t bit = static_cast<uint16_t>(1u << value);
+			chip8.keypad = count ? chip8.keypad | bit : chip8.keypad & ~bit;
+		}
+		else {
+			out << "unknown command " << command << ", try help\n";
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "disassembler.h"
+
+#include <cstdio>
+
+#include "profiler.h"
+
+
+std::string Disassemble(uint16_t opcode, bool xo) {
+	unsigned int x = (opcode & 0x0F00u) >> 8u;
+	unsigned int y = (opcode & 0x00F0u) >> 4u;
+	unsigned int n = opcode & 0x000Fu;
+	unsigned int kk = opcode & 0x00FFu;
+	unsigned int nnn = opcode & 0x0FFFu;
+
+	char text[32];
+
+	switch (DecodeHandler(opcode, xo)) {
+		case HANDLER_00E0: snprintf(text, sizeof(text), "CLS"); break;
+		case HANDLER_00EE: snprintf(text, sizeof(text), "RET"); break;
+		case HANDLER_1nnn: snprintf(text, sizeof(text), "JP 0x%03X", nnn); break;
+		case HANDLER_2nnn: snprintf(text, sizeof(text), "CALL 0x%03X", nnn); break;
+		case HANDLER_3xkk: snprintf(text, sizeof(text), "SE V%X, 0x%02X", x, kk); break;
+		case HANDLER_4xkk: snprintf(text, sizeof(text), "SNE V%X, 0x%02X", x, kk); break;
+		case HANDLER_5xy0: snprintf(text, sizeof(text), "SE V%X, V%X", x, y); break;
+		case HANDLER_6xkk: snprintf(text, sizeof(text), "LD V%X, 0x%02X", x, kk); break;
+		case HANDLER_7xkk: snprintf(text, sizeof(text), "ADD V%X, 0x%02X", x, kk); break;
+		case HANDLER_8xy0: snprintf(text, sizeof(text), "LD V%X, V%X", x, y); break;
+		case HANDLER_8xy1: snprintf(text, sizeof(text), "OR V%X, V%X", x, y); break;
+		case HANDLER_8xy2: snprintf(text, sizeof(text), "AND V%X, V%X", x, y); break;
+		case HANDLER_8xy3: snprintf(text, sizeof(text), "XOR V%X, V%X", x, y); break;
+		case HANDLER_8xy4: snprintf(text, sizeof(text), "ADD V%X, V%X", x, y); break;
+		case HANDLER_8xy5: snprintf(text, sizeof(text), "SUB V%X, V%X", x, y); break;
+		case HANDLER_8xy6: snprintf(text, sizeof(text), "SHR V%X", x); break;
+		case HANDLER_8xy7: snprintf(text, sizeof(text), "SUBN V%X, V%X", x, y); break;
+		case HANDLER_8xyE: snprintf(text, sizeof(text), "SHL V%X", x); break;
+		case HANDLER_9xy0: snprintf(text, sizeof(text), "SNE V%X, V%X", x, y); break;
+		case HANDLER_Annn: snprintf(text, sizeof(text), "LD I, 0x%03X", nnn); break;
+		case HANDLER_Bnnn: snprintf(text, sizeof(text), "JP V0, 0x%03X", nnn); break;
+		case HANDLER_Cxkk: snprintf(text, sizeof(text), "RND V%X, 0x%02X", x, kk); break;
+		case HANDLER_Dxyn: snprintf(text, sizeof(text), "DRW V%X, V%X, %u", x, y, n); break;
+		case HANDLER_Ex9E: snprintf(text, sizeof(text), "SKP V%X", x); break;
+		case HANDLER_ExA1: snprintf(text, sizeof(text), "SKNP V%X", x); break;
+		case HANDLER_Fx07: snprintf(text, sizeof(text), "LD V%X, DT", x); break;
+		case HANDLER_Fx0A: snprintf(text, sizeof(text), "LD V%X, K", x); break;
+		case HANDLER_Fx15: snprintf(text, sizeof(text), "LD DT, V%X", x); break;
+		case HANDLER_Fx18: snprintf(text, sizeof(text), "LD ST, V%X", x); break;
+		case HANDLER_Fx1E: snprintf(text, sizeof(text), "ADD I, V%X", x); break;
+		case HANDLER_Fx29: snprintf(text, sizeof(text), "LD F, V%X", x); break;
+		case HANDLER_Fx33: snprintf(text, sizeof(text), "LD B, V%X", x); break;
+		case HANDLER_Fx55: snprintf(text, sizeof(text), "LD [I], V%X", x); break;
+		case HANDLER_Fx65: snprintf(text, sizeof(text), "LD V%X, [I]", x); break;
+		case HANDLER_00Cn: snprintf(text, sizeof(text), "SCD %u", n); break;
+		case HANDLER_00FB: snprintf(text, sizeof(text), "SCR"); break;
+		case HANDLER_00FC: snprintf(text, sizeof(text), "SCL"); break;
+		case HANDLER_00FD: snprintf(text, sizeof(text), "EXIT"); break;
+		case HANDLER_00FE: snprintf(text, sizeof(text), "LOW"); break;
+		case HANDLER_00FF: snprintf(text, sizeof(text), "HIGH"); break;
+		case HANDLER_Fx30: snprintf(text, sizeof(text), "LD HF, V%X", x); break;
+		case HANDLER_Fx75: snprintf(text, sizeof(text), "LD R, V%X", x); break;
+		case HANDLER_Fx85: snprintf(text, sizeof(text), "LD V%X, R", x); break;
+		case HANDLER_5xy2: snprintf(text, sizeof(text), "LD [I], V%X-V%X", x, y); break;
+		case HANDLER_5xy3: snprintf(text, sizeof(text), "LD V%X-V%X, [I]", x, y); break;
+		case HANDLER_F000: snprintf(text, sizeof(text), "LD I, LONG"); break;
+		case HANDLER_Fn01: snprintf(text, sizeof(text), "PLANE %u", x); break;
+		case HANDLER_F002: snprintf(text, sizeof(text), "AUDIO"); break;
+		case HANDLER_Fx3A: snprintf(text, sizeof(text), "PITCH V%X", x); break;
+		default: snprintf(text, sizeof(text), "DW 0x%04X", opcode); break;
+	}
+
+	return text;
+}
@@ -0,0 +1,605 @@
+#include "fuzzer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "disassembler.h"
+#include "input.h"
+
+
+const char* FuzzEngineName(FuzzEngine engine) {
+	switch (engine) {
+		case FuzzEngine::Reference: return "reference";
+		case FuzzEngine::Batch: return "batch";
+		case FuzzEngine::Snapshot: return "snapshot";
+		case FuzzEngine::Count: break;
+	}
+	return "unknown";
+}
+
+bool ParseFuzzEngine(const char* text, FuzzEngine& engine) {
+	for (int id = 0; id < static_cast<int>(FuzzEngine::Count); ++id) {
+		if (strcmp(text, FuzzEngineName(static_cast<FuzzEngine>(id))) == 0) {
+			engine = static_cast<FuzzEngine>(id);
+			return true;
+		}
+	}
+	return false;
+}
+
+// FNV-1a over 8-byte words, four lanes so the multiplies overlap; a byte
+// at a time the 5 KB state took longer to hash than 64 cycles to run
+static void Mix(uint64_t& hash, const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	size_t i = 0;
+
+	if (size >= 32) {
+		uint64_t lanes[4] = { hash, hash ^ 1, hash ^ 2, hash ^ 3 };
+		for (; i + 32 <= size; i += 32) {
+			for (unsigned int lane = 0; lane < 4; ++lane) {
+				uint64_t word;
+				memcpy(&word, bytes + i + 8 * lane, sizeof(word));
+				lanes[lane] = (lanes[lane] ^ word) * 0x100000001B3ull;
+			}
+		}
+		hash = lanes[0] ^ std::rotl(lanes[1], 16) ^ std::rotl(lanes[2], 32) ^ std::rotl(lanes[3], 48);
+	}
+
+	for (; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+}
+
+// field by field, the padding of the struct is never written by SaveState
+uint64_t HashState(const Chip8State& state) {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	Mix(hash, state.registers, sizeof(state.registers));
+	Mix(hash, state.memory, sizeof(state.memory));
+	Mix(hash, &state.memoryHash, sizeof(state.memoryHash));
+	Mix(hash, &state.index, sizeof(state.index));
+	Mix(hash, &state.pc, sizeof(state.pc));
+	Mix(hash, state.stack, sizeof(state.stack));
+	Mix(hash, &state.sp, sizeof(state.sp));
+	Mix(hash, &state.delayTimer, sizeof(state.delayTimer));
+	Mix(hash, &state.soundTimer, sizeof(state.soundTimer));
+	Mix(hash, &state.keypad, sizeof(state.keypad));
+	Mix(hash, state.video, sizeof(state.video));
+	Mix(hash, state.planeHash, sizeof(state.planeHash));
+	Mix(hash, state.rplFlags, sizeof(state.rplFlags));
+	Mix(hash, &state.hires, sizeof(state.hires));
+	Mix(hash, &state.planeMask, sizeof(state.planeMask));
+	Mix(hash, &state.pitch, sizeof(state.pitch));
+	Mix(hash, state.audioPattern, sizeof(state.audioPattern));
+	Mix(hash, &state.randState, sizeof(state.randState));
+	return hash;
+}
+
+void PrintStateDifference(std::ostream& out, const Chip8State& expected, const Chip8State& actual) {
+	auto field = [&](const char* name, unsigned int a, unsigned int b) {
+		if (a != b) {
+			out << "  " << name << ": 0x" << std::hex << a << " vs 0x" << b << std::dec << "\n";
+		}
+	};
+
+	for (unsigned int reg = 0; reg < 16; ++reg) {
+		std::string name = "V" + std::string(1, "0123456789ABCDEF"[reg]);
+		field(name.c_str(), expected.registers[reg], actual.registers[reg]);
+	}
+	field("I", expected.index, actual.index);
+	field("PC", expected.pc, actual.pc);
+	field("SP", expected.sp, actual.sp);
+	field("DT", expected.delayTimer, actual.delayTimer);
+	field("ST", expected.soundTimer, actual.soundTimer);
+	field("keypad", expected.keypad, actual.keypad);
+	field("hires", expected.hires, actual.hires);
+	field("randState", expected.randState, actual.randState);
+
+	if (memcmp(expected.stack, actual.stack, sizeof(expected.stack)) != 0) {
+		out << "  stack differs\n";
+	}
+	if (memcmp(expected.rplFlags, actual.rplFlags, sizeof(expected.rplFlags)) != 0) {
+		out << "  user flags differ\n";
+	}
+	if (memcmp(expected.planeHash, actual.planeHash, sizeof(expected.planeHash)) != 0) {
+		out << "  frame hash differs\n";
+	}
+	if (expected.memoryHash != actual.memoryHash) {
+		out << "  memory hash differs\n";
+	}
+
+	unsigned int shown = 0;
+	for (unsigned int address = 0; address < sizeof(expected.memory); ++address) {
+		if (expected.memory[address] != actual.memory[address] && shown++ < 8) {
+			std::string name = "memory[" + std::to_string(address) + "]";
+			field(name.c_str(), expected.memory[address], actual.memory[address]);
+		}
+	}
+
+	for (unsigned int row = 0; row < HIRES_HEIGHT; ++row) {
+		for (unsigned int word = 0; word < VIDEO_ROW_WORDS; ++word) {
+			uint64_t diff = expected.video[0][row][word] ^ actual.video[0][row][word];
+			if (diff) {
+				out << "  pixel (" << word * 64 + std::countl_zero(diff) << ", " << row << ") differs\n";
+				return;
+			}
+		}
+	}
+}
+
+namespace {
+	// CHIP-8 and SCHIP with DefaultQuirks, one switch, no shared code with
+	// the core: the display is read and written one pixel at a time
+	class ReferenceMachine {
+	public:
+		Chip8State s;
+
+		void Cycle() {
+			uint16_t opcode = static_cast<uint16_t>((s.memory[s.pc & 0xFFFu] << 8u) | s.memory[(s.pc + 1) & 0xFFFu]);
+			s.pc += 2;
+
+			unsigned int x = (opcode >> 8u) & 0xFu;
+			unsigned int y = (opcode >> 4u) & 0xFu;
+			unsigned int n = opcode & 0xFu;
+			uint8_t kk = opcode & 0xFFu;
+			uint16_t nnn = opcode & 0xFFFu;
+			uint8_t* V = s.registers;
+
+			switch (opcode >> 12u) {
+				case 0x0:
+					if ((kk & 0xF0u) == 0xC0u) {
+						for (unsigned int row = Height(); row-- > 0;) {
+							for (unsigned int col = 0; col < Width(); ++col) {
+								Set(col, row, row >= n && Get(col, row - n));
+							}
+						}
+					}
+					else if (kk == 0xE0) {
+						memset(s.video, 0, sizeof(s.video));
+					}
+					else if (kk == 0xEE) {
+						--s.sp;
+						s.pc = s.stack[s.sp % 16];
+					}
+					else if (kk == 0xFB) {
+						for (unsigned int row = 0; row < Height(); ++row) {
+							for (unsigned int col = Width(); col-- > 0;) {
+								Set(col, row, col >= 4 && Get(col - 4, row));
+							}
+						}
+					}
+					else if (kk == 0xFC) {
+						for (unsigned int row = 0; row < Height(); ++row) {
+							for (unsigned int col = 0; col < Width(); ++col) {
+								Set(col, row, col + 4 < Width() && Get(col + 4, row));
+							}
+						}
+					}
+					else if (kk == 0xFD) {
+						s.pc -= 2;
+					}
+					else if (kk == 0xFE || kk == 0xFF) {
+						s.hires = kk == 0xFF;
+						memset(s.video, 0, sizeof(s.video));
+					}
+					break;
+				case 0x1: s.pc = nnn; break;
+				case 0x2: s.stack[s.sp % 16] = s.pc; ++s.sp; s.pc = nnn; break;
+				case 0x3: if (V[x] == kk) s.pc += 2; break;
+				case 0x4: if (V[x] != kk) s.pc += 2; break;
+				case 0x5: if (V[x] == V[y]) s.pc += 2; break;
+				case 0x6: V[x] = kk; break;
+				case 0x7: V[x] += kk; break;
+				case 0x8:
+					switch (n) {
+						case 0x0: V[x] = V[y]; break;
+						case 0x1: V[x] |= V[y]; break;
+						case 0x2: V[x] &= V[y]; break;
+						case 0x3: V[x] ^= V[y]; break;
+						case 0x4: { unsigned int sum = V[x] + V[y]; V[0xF] = sum > 0xFF; V[x] = static_cast<uint8_t>(sum); break; }
+						case 0x5: V[0xF] = V[x] > V[y]; V[x] -= V[y]; break;
+						case 0x6: { uint8_t value = V[x]; V[0xF] = value & 1u; V[x] = value >> 1u; break; }
+						case 0x7: V[0xF] = V[y] > V[x]; V[x] = V[y] - V[x]; break;
+						case 0xE: { uint8_t value = V[x]; V[0xF] = value >> 7u; V[x] = static_cast<uint8_t>(value << 1u); break; }
+					}
+					break;
+				case 0x9: if (V[x] != V[y]) s.pc += 2; break;
+				case 0xA: s.index = nnn; break;
+				case 0xB: s.pc = V[0] + nnn; break;
+				case 0xC: V[x] = Random() & kk; break;
+				case 0xD: Draw(V[x], V[y], n); break;
+				case 0xE:
+					if (n == 0xE && ((s.keypad >> (V[x] & 0xFu)) & 1u)) s.pc += 2;
+					if (n == 0x1 && !((s.keypad >> (V[x] & 0xFu)) & 1u)) s.pc += 2;
+					break;
+				case 0xF:
+					switch (kk) {
+						case 0x07: V[x] = s.delayTimer; break;
+						case 0x0A:
+							if (s.keypad) {
+								V[x] = static_cast<uint8_t>(std::countr_zero(s.keypad));
+							}
+							else {
+								s.pc -= 2;
+							}
+							break;
+						case 0x15: s.delayTimer = V[x]; break;
+						case 0x18: s.soundTimer = V[x]; break;
+						case 0x1E: s.index += V[x]; break;
+						case 0x29: s.index = static_cast<uint16_t>(FONTSET_START_ADDRESS + 5 * V[x]); break;
+						case 0x30: s.index = static_cast<uint16_t>(BIG_FONTSET_START_ADDRESS + 10 * (V[x] & 0xFu)); break;
+						case 0x33:
+							s.memory[s.index & 0xFFFu] = V[x] / 100;
+							s.memory[(s.index + 1) & 0xFFFu] = V[x] / 10 % 10;
+							s.memory[(s.index + 2) & 0xFFFu] = V[x] % 10;
+							break;
+						case 0x55: for (unsigned int i = 0; i <= x; ++i) s.memory[(s.index + i) & 0xFFFu] = V[i]; break;
+						case 0x65: for (unsigned int i = 0; i <= x; ++i) V[i] = s.memory[(s.index + i) & 0xFFFu]; break;
+						case 0x75: for (unsigned int i = 0; i <= x; ++i) s.rplFlags[i] = V[i]; break;
+						case 0x85: for (unsigned int i = 0; i <= x; ++i) V[i] = s.rplFlags[i]; break;
+					}
+					break;
+			}
+
+			if (s.delayTimer) --s.delayTimer;
+			if (s.soundTimer) --s.soundTimer;
+		}
+
+	private:
+		unsigned int Width() const { return s.hires ? HIRES_WIDTH : VIDEO_WIDTH; }
+		unsigned int Height() const { return s.hires ? HIRES_HEIGHT : VIDEO_HEIGHT; }
+
+		bool Get(unsigned int col, unsigned int row) const {
+			return (s.video[0][row][col / 64] >> (63 - col % 64)) & 1u;
+		}
+
+		void Set(unsigned int col, unsigned int row, bool on) {
+			uint64_t bit = 1ull << (63 - col % 64);
+			s.video[0][row][col / 64] = on ? s.video[0][row][col / 64] | bit : s.video[0][row][col / 64] & ~bit;
+		}
+
+		void Draw(uint8_t vx, uint8_t vy, unsigned int n) {
+			unsigned int left = vx % Width();
+			unsigned int top = vy % Height();
+			unsigned int width = n ? 8 : 16;
+			unsigned int rows = n ? n : 16;
+
+			s.registers[0xF] = 0;
+			for (unsigned int row = 0; row < rows && top + row < Height(); ++row) {
+				for (unsigned int col = 0; col < width && left + col < Width(); ++col) {
+					unsigned int byte = n ? row : 2 * row + col / 8;
+					if ((s.memory[(s.index + byte) & 0xFFFu] >> (7 - col % 8)) & 1u) {
+						if (Get(left + col, top + row)) {
+							s.registers[0xF] = 1;
+						}
+						Set(left + col, top + row, !Get(left + col, top + row));
+					}
+				}
+			}
+		}
+
+		uint8_t Random() {
+			s.randState ^= s.randState << 13u;
+			s.randState ^= s.randState >> 17u;
+			s.randState ^= s.randState << 5u;
+			return static_cast<uint8_t>(s.randState >> 24u);
+		}
+	};
+
+	struct OpcodeTemplate {
+		uint16_t base;
+		uint16_t random;    // bits filled at random
+		bool target;        // nnn aimed at a word of the ROM
+	};
+
+	const OpcodeTemplate TEMPLATES[] = {
+		{ 0x00E0, 0x0000, false }, { 0x00EE, 0x0000, false }, { 0x00C0, 0x000F, false },
+		{ 0x00FB, 0x0000, false }, { 0x00FC, 0x0000, false }, { 0x00FE, 0x0000, false }, { 0x00FF, 0x0000, false },
+		{ 0x1000, 0x0000, true }, { 0x2000, 0x0000, true }, { 0x3000, 0x0FFF, false }, { 0x4000, 0x0FFF, false },
+		{ 0x5000, 0x0FF0, false }, { 0x6000, 0x0FFF, false }, { 0x7000, 0x0FFF, false },
+		{ 0x8000, 0x0FF0, false }, { 0x8001, 0x0FF0, false }, { 0x8002, 0x0FF0, false }, { 0x8003, 0x0FF0, false },
+		{ 0x8004, 0x0FF0, false }, { 0x8005, 0x0FF0, false }, { 0x8006, 0x0FF0, false }, { 0x8007, 0x0FF0, false },
+		{ 0x800E, 0x0FF0, false }, { 0x9000, 0x0FF0, false }, { 0xA000, 0x0FFF, false }, { 0xA000, 0x0000, true },
+		{ 0xB000, 0x0000, true }, { 0xC000, 0x0FFF, false }, { 0xD000, 0x0FFF, false }, { 0xD000, 0x0FF0, false },
+		{ 0xE09E, 0x0F00, false }, { 0xE0A1, 0x0F00, false }, { 0xF007, 0x0F00, false }, { 0xF00A, 0x0F00, false },
+		{ 0xF015, 0x0F00, false }, { 0xF018, 0x0F00, false }, { 0xF01E, 0x0F00, false }, { 0xF029, 0x0F00, false },
+		{ 0xF030, 0x0F00, false }, { 0xF033, 0x0F00, false }, { 0xF055, 0x0F00, false }, { 0xF065, 0x0F00, false },
+		{ 0xF075, 0x0700, false }, { 0xF085, 0x0700, false },
+	};
+	const size_t TEMPLATE_COUNT = sizeof(TEMPLATES) / sizeof(TEMPLATES[0]);
+
+	// a fresh machine for the case, RNG seeded, keypad up
+	void Boot(Chip8& chip8, const FuzzCase& fuzzCase) {
+		chip8.LoadROM(std::span<const uint8_t>(fuzzCase.rom.data(), std::min<size_t>(fuzzCase.rom.size(), MAX_ROM_SIZE)));
+		chip8.Seed(fuzzCase.seed);
+	}
+
+	// run one engine over [from, to), applying every key event due
+	template <typename Step>
+	void Advance(const FuzzCase& fuzzCase, size_t& key, uint32_t from, uint32_t to, uint16_t& keypad, Step step) {
+		for (uint32_t cycle = from; cycle < to; ++cycle) {
+			while (key < fuzzCase.keys.size() && fuzzCase.keys[key].cycle <= cycle) {
+				keypad = fuzzCase.keys[key++].keypad;
+			}
+			step();
+		}
+	}
+}
+
+FuzzCase GenerateFuzzCase(std::mt19937_64& generator) {
+	FuzzCase fuzzCase;
+	size_t words = 16 + generator() % 241;
+	fuzzCase.rom.resize(2 * words);
+
+	for (size_t word = 0; word < words; ++word) {
+		uint16_t opcode = static_cast<uint16_t>(generator());
+		if (generator() % 100 >= 5) {
+			const OpcodeTemplate& pick = TEMPLATES[generator() % TEMPLATE_COUNT];
+			opcode = static_cast<uint16_t>(pick.base | (generator() & pick.random));
+			if (pick.target) {
+				opcode |= static_cast<uint16_t>(START_ADDRESS + 2 * (generator() % words));
+			}
+		}
+		fuzzCase.rom[2 * word] = static_cast<uint8_t>(opcode >> 8u);
+		fuzzCase.rom[2 * word + 1] = static_cast<uint8_t>(opcode);
+	}
+
+	fuzzCase.seed = static_cast<uint32_t>(generator());
+	fuzzCase.cycles = 1000 + static_cast<uint32_t>(generator() % 9000);
+
+	// mostly single keys and releases, now and then a chord
+	size_t keys = generator() % 17;
+	for (size_t k = 0; k < keys; ++k) {
+		uint32_t cycle = static_cast<uint32_t>(generator() % fuzzCase.cycles);
+		uint64_t kind = generator() % 8;
+		uint16_t keypad = kind < 4 ? 0 : kind < 7 ? static_cast<uint16_t>(1u << (generator() % 16)) : static_cast<uint16_t>(generator());
+		fuzzCase.keys.push_back({ cycle, keypad });
+	}
+	std::stable_sort(fuzzCase.keys.begin(), fuzzCase.keys.end(), [](const FuzzKey& a, const FuzzKey& b) { return a.cycle < b.cycle; });
+
+	return fuzzCase;
+}
+
+bool RunFuzzCase(const FuzzCase& fuzzCase, FuzzEngine engine, uint32_t checkInterval, FuzzMismatch* mismatch) {
+	if (checkInterval == 0) {
+		checkInterval = 1;
+	}
+
+	Chip8 expected;
+	Boot(expected, fuzzCase);
+	size_t expectedKey = 0;
+
+	// the other engine, only the one in use is touched
+	ReferenceMachine reference;
+	Chip8 machines[2];
+	unsigned int current = 0;
+	InputRing input;
+	size_t actualKey = 0;
+	const uint64_t cycleNanoseconds = 1000;
+
+	if (engine == FuzzEngine::Reference) {
+		expected.SaveState(reference.s);
+	}
+	else {
+		Boot(machines[0], fuzzCase);
+	}
+
+	Chip8State expectedState, actualState;
+
+	for (uint32_t cycle = 0; cycle < fuzzCase.cycles;) {
+		uint32_t end = std::min(fuzzCase.cycles, cycle + checkInterval);
+
+		Advance(fuzzCase, expectedKey, cycle, end, expected.keypad, [&]() { expected.Cycle(); });
+
+		switch (engine) {
+			case FuzzEngine::Reference:
+				Advance(fuzzCase, actualKey, cycle, end, reference.s.keypad, [&]() { reference.Cycle(); });
+				actualState = reference.s;
+				// the reference keeps no hashes, the machine's incremental ones must match its bytes
+				Chip8::Rehash(actualState);
+				break;
+
+			case FuzzEngine::Batch: {
+				// events of the window stamped with their cycle, delivered by RunBatch
+				while (actualKey < fuzzCase.keys.size() && fuzzCase.keys[actualKey].cycle < end) {
+					const FuzzKey& key = fuzzCase.keys[actualKey++];
+					input.Push({ std::max(key.cycle, cycle) * cycleNanoseconds, key.keypad });
+				}
+				NullProfiler profiler;
+				RunBatch(machines[0], input, cycle * cycleNanoseconds, cycleNanoseconds, end - cycle, profiler);
+				machines[0].SaveState(actualState);
+				break;
+			}
+
+			case FuzzEngine::Snapshot:
+				Advance(fuzzCase, actualKey, cycle, end, machines[current].keypad, [&]() { machines[current].Cycle(); });
+				machines[current].SaveState(actualState);
+				// continue on the other machine, over whatever state it held
+				current ^= 1u;
+				machines[current].LoadState(actualState);
+				break;
+
+			case FuzzEngine::Count:
+				return true;
+		}
+
+		expected.SaveState(expectedState);
+		cycle = end;
+
+		if (HashState(expectedState) != HashState(actualState)) {
+			if (mismatch) {
+				mismatch->cycle = cycle;
+				mismatch->expected = expectedState;
+				mismatch->actual = actualState;
+			}
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FuzzCase MinimizeFuzzCase(const FuzzCase& fuzzCase, FuzzEngine engine) {
+	FuzzCase best = fuzzCase;
+	auto mismatch = std::make_unique<FuzzMismatch>();
+
+	// stop right after the first instruction that differs
+	auto cut = [&](FuzzCase& candidate) {
+		if (RunFuzzCase(candidate, engine, 1, mismatch.get())) {
+			return false;
+		}
+		candidate.cycles = mismatch->cycle;
+		while (!candidate.keys.empty() && candidate.keys.back().cycle >= candidate.cycles) {
+			candidate.keys.pop_back();
+		}
+		return true;
+	};
+
+	if (!cut(best)) {
+		return best;
+	}
+
+	for (size_t k = best.keys.size(); k-- > 0;) {
+		FuzzCase candidate = best;
+		candidate.keys.erase(candidate.keys.begin() + k);
+		if (cut(candidate)) {
+			best = candidate;
+		}
+	}
+
+	// 0000 does nothing, so a zeroed word only removes behaviour
+	for (size_t word = 0; 2 * word + 1 < best.rom.size(); ++word) {
+		if (best.rom[2 * word] == 0 && best.rom[2 * word + 1] == 0) {
+			continue;
+		}
+		FuzzCase candidate = best;
+		candidate.rom[2 * word] = 0;
+		candidate.rom[2 * word + 1] = 0;
+		if (cut(candidate)) {
+			best = candidate;
+		}
+	}
+
+	// memory past the ROM is zero anyway
+	while (best.rom.size() >= 2 && best.rom[best.rom.size() - 1] == 0 && best.rom[best.rom.size() - 2] == 0) {
+		best.rom.resize(best.rom.size() - 2);
+	}
+
+	return best;
+}
+
+static void PrintFuzzCase(std::ostream& out, const FuzzCase& fuzzCase) {
+	out << "seed " << fuzzCase.seed << ", " << fuzzCase.cycles << " cycles, " << fuzzCase.rom.size() << " ROM bytes\n";
+	for (const FuzzKey& key : fuzzCase.keys) {
+		out << "  cycle " << key.cycle << ": keypad 0x" << std::hex << std::setw(4) << std::setfill('0') << key.keypad << std::dec << std::setfill(' ') << "\n";
+	}
+	for (size_t i = 0; i + 1 < fuzzCase.rom.size(); i += 2) {
+		uint16_t opcode = static_cast<uint16_t>((fuzzCase.rom[i] << 8u) | fuzzCase.rom[i + 1]);
+		if (opcode) {
+			out << "  " << std::hex << std::setw(3) << START_ADDRESS + i << ": " << std::setw(4) << std::setfill('0') << opcode
+				<< std::dec << std::setfill(' ') << "  " << Disassemble(opcode) << "\n";
+		}
+	}
+}
+
+int RunFuzzer(FuzzEngine engine, uint64_t cases, unsigned int threads, uint64_t seed, uint32_t checkInterval) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	std::atomic<uint64_t> next{ 0 };
+	std::atomic<uint64_t> failures{ 0 };
+	std::atomic<uint64_t> cycles{ 0 };
+	std::mutex firstMutex;
+	uint64_t firstFailure = UINT64_MAX;
+
+	// case n is generated from seed and n alone, so any case can be rerun by itself
+	auto worker = [&]() {
+		uint64_t executed = 0;
+		for (uint64_t n = next++; n < cases; n = next++) {
+			std::mt19937_64 generator(seed * 0x9E3779B97F4A7C15ull + n);
+			FuzzCase fuzzCase = GenerateFuzzCase(generator);
+			executed += fuzzCase.cycles;
+
+			if (!RunFuzzCase(fuzzCase, engine, checkInterval)) {
+				++failures;
+				std::lock_guard<std::mutex> lock(firstMutex);
+				firstFailure = std::min(firstFailure, n);
+			}
+		}
+		cycles += executed;
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (unsigned int t = 0; t < threads; ++t) {
+		pool.emplace_back(worker);
+	}
+	for (std::thread& thread : pool) {
+		thread.join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "fuzz " << FuzzEngineName(engine) << ": " << cases << " cases on " << threads << " thread(s) in " << seconds << " s, "
+		<< cases / seconds << " cases/s (" << cases / seconds * 3600.0 / 1e6 << " M/hour), "
+		<< cycles / seconds / 1e6 << " M cycles/s per engine, " << failures << " mismatch(es)\n";
+
+	if (firstFailure == UINT64_MAX) {
+		return 0;
+	}
+
+	std::mt19937_64 generator(seed * 0x9E3779B97F4A7C15ull + firstFailure);
+	FuzzCase minimized = MinimizeFuzzCase(GenerateFuzzCase(generator), engine);
+
+	auto mismatch = std::make_unique<FuzzMismatch>();
+	RunFuzzCase(minimized, engine, 1, mismatch.get());
+
+	std::cout << "first failure, case " << firstFailure << ", minimized: ";
+	PrintFuzzCase(std::cout, minimized);
+	std::cout << "after " << mismatch->cycle << " cycles, Chip8::Cycle vs " << FuzzEngineName(engine) << ":\n";
+	PrintStateDifference(std::cout, mismatch->expected, mismatch->actual);
+
+	std::ofstream file("fuzz_failure.ch8", std::ios::binary);
+	file.write(reinterpret_cast<const char*>(minimized.rom.data()), static_cast<std::streamsize>(minimized.rom.size()));
+	std::cout << "ROM written to fuzz_failure.ch8\n";
+
+	return 1;
+}
+
+#if defined(CHIP8_LIBFUZZER)
+// engine, seed, cycles, key events, then the ROM
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	if (size < 8) {
+		return 0;
+	}
+
+	FuzzEngine engine = static_cast<FuzzEngine>(data[0] % static_cast<uint8_t>(FuzzEngine::Count));
+	FuzzCase fuzzCase;
+	fuzzCase.seed = static_cast<uint32_t>(data[1] | (data[2] << 8u) | (data[3] << 16u) | (data[4] << 24u));
+	fuzzCase.cycles = 1 + (data[5] | (data[6] << 8u)) % 10000u;
+
+	size_t offset = 8;
+	for (unsigned int k = 0; k < data[7] % 16u && offset + 4 <= size; ++k, offset += 4) {
+		uint32_t cycle = (data[offset] | (data[offset + 1] << 8u)) % fuzzCase.cycles;
+		fuzzCase.keys.push_back({ cycle, static_cast<uint16_t>(data[offset + 2] | (data[offset + 3] << 8u)) });
+	}
+	std::stable_sort(fuzzCase.keys.begin(), fuzzCase.keys.end(), [](const FuzzKey& a, const FuzzKey& b) { return a.cycle < b.cycle; });
+
+	fuzzCase.rom.assign(data + std::min(offset, size), data + std::min(size, offset + MAX_ROM_SIZE));
+
+	if (!RunFuzzCase(fuzzCase, engine, 1)) {
+		std::abort();
+	}
+	return 0;
+}
+#endif
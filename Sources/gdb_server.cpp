@@ -0,0 +1,619 @@
+#include "gdb_server.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#define SEND_FLAGS 0
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+// a client that went away must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+#endif
+
+
+static const char* targetXml =
+	"<?xml version=\"1.0\"?>\n"
+	"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+	"<target version=\"1.0\">\n"
+	"  <feature name=\"org.chip8.core\">\n"
+	"    <reg name=\"v0\" bitsize=\"8\" type=\"uint8\" regnum=\"0\"/>\n"
+	"    <reg name=\"v1\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v2\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v3\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v4\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v5\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v6\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v7\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v8\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"v9\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"va\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"vb\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"vc\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"vd\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"ve\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"vf\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"    <reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>\n"
+	"    <reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>\n"
+	"    <reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>\n"
+	"  </feature>\n"
+	"</target>\n";
+
+static const unsigned int REGISTER_I = 16;
+static const unsigned int REGISTER_PC = 17;
+static const unsigned int REGISTER_SP = 18;
+
+static void CloseSocket(intptr_t handle) {
+#ifdef _WIN32
+	closesocket(static_cast<SOCKET>(handle));
+#else
+	close(static_cast<int>(handle));
+#endif
+}
+
+static void SetNonBlocking(intptr_t handle) {
+#ifdef _WIN32
+	u_long enabled = 1;
+	ioctlsocket(static_cast<SOCKET>(handle), FIONBIO, &enabled);
+#else
+	fcntl(static_cast<int>(handle), F_SETFL, fcntl(static_cast<int>(handle), F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+static bool WouldBlock() {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+static void AppendHex(std::string& out, unsigned int value, int bytes) {
+	// multi-byte registers go little endian, like every GDB target
+	static const char digits[] = "0123456789abcdef";
+	for (int i = 0; i < bytes; ++i) {
+		uint8_t byte = (value >> (8 * i)) & 0xFFu;
+		out += digits[byte >> 4u];
+		out += digits[byte & 0xFu];
+	}
+}
+
+static bool ParseHex(const std::string& text, unsigned long& value) {
+	if (text.empty()) {
+		return false;
+	}
+	char* end = nullptr;
+	value = std::strtoul(text.c_str(), &end, 16);
+	return *end == '\0';
+}
+
+// little-endian hex bytes back into a value
+static bool ParseHexBytes(const std::string& text, unsigned long& value) {
+	if (text.empty() || text.size() % 2 || text.size() > 8) {
+		return false;
+	}
+	value = 0;
+	for (size_t i = 0; i < text.size(); i += 2) {
+		unsigned long byte = 0;
+		if (!ParseHex(text.substr(i, 2), byte)) {
+			return false;
+		}
+		value |= byte << (4 * i);
+	}
+	return true;
+}
+
+
+GdbServer::~GdbServer() {
+	Close();
+}
+
+bool GdbServer::Listen(uint16_t port) {
+	Close();
+
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+		return false;
+	}
+#endif
+
+	intptr_t handle = static_cast<intptr_t>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if (handle == INVALID) {
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	if (bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(handle, 1) != 0) {
+		CloseSocket(handle);
+		return false;
+	}
+
+	SetNonBlocking(handle);
+	listener = handle;
+	return true;
+}
+
+void GdbServer::Close() {
+	Detach();
+	if (listener != INVALID) {
+		CloseSocket(listener);
+		listener = INVALID;
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+}
+
+void GdbServer::Accept() {
+	intptr_t handle = static_cast<intptr_t>(accept(listener, nullptr, nullptr));
+	if (handle == INVALID) {
+		return;
+	}
+
+	// packets are small and latency bound
+	int noDelay = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+	SetNonBlocking(handle);
+
+	client = handle;
+	input.clear();
+	debugger.ClearAll();
+	halted = true;      // a debugger expects the target stopped when it attaches
+	resuming = false;
+	noAck = false;
+}
+
+void GdbServer::Detach() {
+	if (client != INVALID) {
+		CloseSocket(client);
+		client = INVALID;
+	}
+	debugger.ClearAll();
+	halted = false;
+}
+
+void GdbServer::Poll(Chip8& chip8) {
+	if (client == INVALID) {
+		if (listener != INVALID) {
+			Accept();
+		}
+		if (client == INVALID) {
+			return;
+		}
+		timeline.Start(chip8);
+	}
+
+	Receive(chip8);
+}
+
+void GdbServer::Receive(Chip8& chip8) {
+	char buffer[4096];
+	bool closed = false;
+	for (;;) {
+		auto received = recv(client, buffer, static_cast<int>(sizeof(buffer)), 0);
+		if (received > 0) {
+			input.append(buffer, static_cast<size_t>(received));
+			continue;
+		}
+		closed = received == 0 || !WouldBlock();
+		break;
+	}
+
+	// a client may send its last packet (D or k) and close right away
+	Process(chip8);
+	if (closed) {
+		Detach();
+	}
+}
+
+void GdbServer::Process(Chip8& chip8) {
+	while (!input.empty()) {
+		char first = input[0];
+
+		// acks, and Ctrl-C to interrupt a running target
+		if (first == '+' || first == '-') {
+			input.erase(0, 1);
+			continue;
+		}
+		if (first == '\x03') {
+			input.erase(0, 1);
+			if (!halted) {
+				halted = true;
+				Send("S02");
+			}
+			continue;
+		}
+		if (first != '$') {
+			input.erase(0, 1);
+			continue;
+		}
+
+		size_t end = input.find('#');
+		if (end == std::string::npos || input.size() < end + 3) {
+			return;     // rest of the packet has not arrived yet
+		}
+
+		std::string packet = input.substr(1, end - 1);
+		input.erase(0, end + 3);
+
+		if (!noAck) {
+			send(client, "+", 1, SEND_FLAGS);
+		}
+		Handle(chip8, packet);
+
+		if (client == INVALID) {
+			return;
+		}
+	}
+}
+
+void GdbServer::Send(const std::string& payload) {
+	if (client == INVALID) {
+		return;
+	}
+
+	uint8_t checksum = 0;
+	for (char c : payload) {
+		checksum += static_cast<uint8_t>(c);
+	}
+
+	std::string packet = "$" + payload + "#";
+	AppendHex(packet, checksum, 1);
+
+	// replies are a few KB at most, wait out a full send buffer
+	size_t sent = 0;
+	while (sent < packet.size()) {
+		auto written = send(client, packet.data() + sent, static_cast<int>(packet.size() - sent), SEND_FLAGS);
+		if (written > 0) {
+			sent += static_cast<size_t>(written);
+		}
+		else if (!WouldBlock()) {
+			Detach();
+			return;
+		}
+	}
+}
+
+void GdbServer::Stop(StopReason reason) {
+	halted = true;
+
+	if (reason == StopReason::Breakpoint) {
+		Send("T05swbreak:;");
+	}
+	else if (reason == StopReason::Watchpoint && !debugger.HitRegister()) {
+		std::string reply = "T05watch:";
+		AppendHex(reply, debugger.HitAddress() >> 8u, 1);
+		AppendHex(reply, debugger.HitAddress() & 0xFFu, 1);
+		Send(reply + ";");
+	}
+	else {
+		Send("S05");
+	}
+}
+
+void GdbServer::Run(Chip8& chip8, uint64_t cycles) {
+	if (client == INVALID || halted) {
+		return;
+	}
+
+	// only the first Run after a continue steps over a breakpoint at PC
+	StopReason reason = timeline.Run(chip8, debugger, cycles, resuming);
+	resuming = false;
+	if (reason == StopReason::Breakpoint || reason == StopReason::Watchpoint) {
+		Stop(reason);
+	}
+}
+
+std::string GdbServer::ReadRegisters(const Chip8& chip8) const {
+	std::string out;
+	for (uint8_t r = 0; r < 16; ++r) {
+		AppendHex(out, chip8.Register(r), 1);
+	}
+	AppendHex(out, chip8.Index(), 2);
+	AppendHex(out, chip8.ProgramCounter(), 2);
+	AppendHex(out, chip8.StackPointer(), 1);
+	return out;
+}
+
+std::string GdbServer::ReadMemory(const Chip8& chip8, const std::string& args) const {
+	size_t comma = args.find(',');
+	unsigned long address = 0;
+	unsigned long length = 0;
+	if (comma == std::string::npos || !ParseHex(args.substr(0, comma), address) || !ParseHex(args.substr(comma + 1), length)) {
+		return "E01";
+	}
+	if (address >= 4096) {
+		return "E14";
+	}
+
+	std::string out;
+	for (unsigned long i = 0; i < length && address + i < 4096; ++i) {
+		AppendHex(out, chip8.ReadMemory(static_cast<uint16_t>(address + i)), 1);
+	}
+	return out;
+}
+
+bool GdbServer::WriteMemory(Chip8& chip8, const std::string& args) {
+	size_t comma = args.find(',');
+	size_t colon = args.find(':');
+	unsigned long address = 0;
+	unsigned long length = 0;
+	if (comma == std::string::npos || colon == std::string::npos || !ParseHex(args.substr(0, comma), address)
+		|| !ParseHex(args.substr(comma + 1, colon - comma - 1), length) || args.size() - colon - 1 != 2 * length
+		|| address + length > 4096) {
+		return false;
+	}
+
+	// writes go through a snapshot, the core has no setters
+	Chip8State state;
+	chip8.SaveState(state);
+	for (unsigned long i = 0; i < length; ++i) {
+		unsigned long byte = 0;
+		if (!ParseHex(args.substr(colon + 1 + 2 * i, 2), byte)) {
+			return false;
+		}
+		state.memory[address + i] = static_cast<uint8_t>(byte);
+	}
+	Chip8::Rehash(state);
+	chip8.LoadState(state);
+
+	// replay cannot reproduce a write from outside, history starts again here
+	timeline.Start(chip8);
+	return true;
+}
+
+bool GdbServer::WriteRegister(Chip8& chip8, unsigned int reg, const std::string& value) {
+	unsigned long parsed = 0;
+	if (reg > REGISTER_SP || !ParseHexBytes(value, parsed)) {
+		return false;
+	}
+
+	Chip8State state;
+	chip8.SaveState(state);
+	if (reg < 16) {
+		state.registers[reg] = static_cast<uint8_t>(parsed);
+	}
+	else if (reg == REGISTER_I) {
+		state.index = static_cast<uint16_t>(parsed);
+	}
+	else if (reg == REGISTER_PC) {
+		state.pc = static_cast<uint16_t>(parsed & 0x0FFFu);
+	}
+	else {
+		state.sp = static_cast<uint8_t>(parsed & 0xFu);
+	}
+	chip8.LoadState(state);
+	timeline.Start(chip8);
+	return true;
+}
+
+std::string GdbServer::Breakpoint(const std::string& args, bool insert) {
+	// type,addr,kind
+	size_t first = args.find(',');
+	size_t second = args.find(',', first + 1);
+	unsigned long address = 0;
+	if (first == std::string::npos || !ParseHex(args.substr(first + 1, second - first - 1), address) || address >= 4096) {
+		return "E01";
+	}
+
+	switch (args[0]) {
+		case '0':
+		case '1':
+			debugger.SetBreakpoint(static_cast<uint16_t>(address), insert);
+			return "OK";
+		case '2': {
+			unsigned long length = 1;
+			if (second != std::string::npos) {
+				ParseHex(args.substr(second + 1), length);
+			}
+			for (unsigned long i = 0; i < length && address + i < 4096; ++i) {
+				debugger.SetMemoryWatch(static_cast<uint16_t>(address + i), insert);
+			}
+			return "OK";
+		}
+		default:
+			return "";      // read and access watchpoints are not supported
+	}
+}
+
+void GdbServer::Handle(Chip8& chip8, const std::string& packet) {
+	if (packet.empty()) {
+		Send("");
+		return;
+	}
+
+	std::string args = packet.substr(1);
+
+	switch (packet[0]) {
+		case '?':
+			Send("S05");
+			return;
+		case 'g':
+			Send(ReadRegisters(chip8));
+			return;
+		case 'G': {
+			// every register in the order of the g reply
+			std::string reply = "OK";
+			size_t offset = 0;
+			for (unsigned int reg = 0; reg <= REGISTER_SP && reply == "OK"; ++reg) {
+				size_t width = reg == REGISTER_I || reg == REGISTER_PC ? 4 : 2;
+				if (offset + width > args.size() || !WriteRegister(chip8, reg, args.substr(offset, width))) {
+					reply = "E01";
+				}
+				offset += width;
+			}
+			Send(reply);
+			return;
+		}
+		case 'p': {
+			unsigned long reg = 0;
+			if (!ParseHex(args, reg) || reg > REGISTER_SP) {
+				Send("E01");
+				return;
+			}
+			std::string registers = ReadRegisters(chip8);
+			size_t offset = reg < 16 ? 2 * reg : reg == REGISTER_I ? 32 : reg == REGISTER_PC ? 36 : 40;
+			Send(registers.substr(offset, reg == REGISTER_I || reg == REGISTER_PC ? 4 : 2));
+			return;
+		}
+		case 'P': {
+			size_t equals = args.find('=');
+			unsigned long reg = 0;
+			bool ok = equals != std::string::npos && ParseHex(args.substr(0, equals), reg)
+				&& WriteRegister(chip8, static_cast<unsigned int>(reg), args.substr(equals + 1));
+			Send(ok ? "OK" : "E01");
+			return;
+		}
+		case 'm':
+			Send(ReadMemory(chip8, args));
+			return;
+		case 'M':
+			Send(WriteMemory(chip8, args) ? "OK" : "E01");
+			return;
+		case 'Z':
+		case 'z':
+			Send(Breakpoint(args, packet[0] == 'Z'));
+			return;
+		case 's': {
+			StopReason reason = timeline.Run(chip8, debugger, 1);
+			Stop(reason == StopReason::Watchpoint ? reason : StopReason::Step);
+			return;
+		}
+		case 'b':
+			// reverse execution; the history ends at the point the client attached or last wrote state
+			if (packet == "bs") {
+				halted = true;
+				Send(timeline.ReverseStep(chip8, 1) ? "S05" : "T05replaylog:begin;");
+			}
+			else if (packet == "bc") {
+				halted = true;
+				Send(timeline.ReverseContinue(chip8, debugger) == StopReason::Breakpoint ? "T05swbreak:;" : "T05replaylog:begin;");
+			}
+			else {
+				Send("");
+			}
+			return;
+		case 'c':
+			// the reply is sent by Run once the target stops
+			halted = false;
+			resuming = true;
+			return;
+		case 'H':
+			Send("OK");
+			return;
+		case 'D':
+			Send("OK");
+			Detach();
+			return;
+		case 'k':
+			killed = true;
+			Detach();
+			return;
+		default:
+			break;
+	}
+
+	if (packet.starts_with("qSupported")) {
+		Send("PacketSize=4000;qXfer:features:read+;swbreak+;QStartNoAckMode+;ReverseStep+;ReverseContinue+");
+	}
+	else if (packet == "QStartNoAckMode") {
+		Send("OK");
+		noAck = true;
+	}
+	else if (packet.starts_with("qXfer:features:read:target.xml:")) {
+		unsigned long offset = 0;
+		unsigned long length = 0;
+		std::string range = packet.substr(sizeof("qXfer:features:read:target.xml:") - 1);
+		size_t comma = range.find(',');
+		if (comma == std::string::npos || !ParseHex(range.substr(0, comma), offset) || !ParseHex(range.substr(comma + 1), length)) {
+			Send("E01");
+			return;
+		}
+		std::string xml = targetXml;
+		if (offset >= xml.size()) {
+			Send("l");
+			return;
+		}
+		std::string chunk = xml.substr(offset, length);
+		Send((offset + chunk.size() < xml.size() ? "m" : "l") + chunk);
+	}
+	else if (packet == "qAttached") {
+		Send("1");
+	}
+	else if (packet == "qC") {
+		Send("QC1");
+	}
+	else if (packet == "qfThreadInfo") {
+		Send("m1");
+	}
+	else if (packet == "qsThreadInfo") {
+		Send("l");
+	}
+	else {
+		Send("");       // not supported
+	}
+}
+
+
+int RunGdbServer(const char* romFilename, uint16_t port, unsigned int cyclesPerFrame) {
+	Chip8 chip8;
+	LoadResult loaded = chip8.LoadROM(romFilename);
+	if (loaded != LoadResult::Ok) {
+		std::cerr << "Cannot load " << romFilename << ": " << LoadResultMessage(loaded) << "\n";
+		return 1;
+	}
+
+	GdbServer server;
+	if (!server.Listen(port)) {
+		std::cerr << "Cannot listen on port " << port << "\n";
+		return 1;
+	}
+
+	std::cout << "Waiting for a debugger on localhost:" << port << "\n";
+
+	auto frameTime = std::chrono::microseconds(1000000 / 60);
+	auto nextFrame = std::chrono::steady_clock::now();
+
+	while (!server.Killed()) {
+		server.Poll(chip8);
+
+		if (!server.Attached()) {
+			for (unsigned int i = 0; i < cyclesPerFrame; ++i) {
+				chip8.Cycle();
+			}
+		}
+		else if (!server.Halted()) {
+			server.Run(chip8, cyclesPerFrame);
+		}
+
+		nextFrame += frameTime;
+		std::this_thread::sleep_until(nextFrame);
+	}
+
+	return 0;
+}
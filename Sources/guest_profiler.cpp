@@ -0,0 +1,154 @@
+#include "guest_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <string>
+
+
+template <unsigned int MemorySize>
+BasicGuestProfiler<MemorySize>::BasicGuestProfiler() : addressCounts(MemorySize) {
+	// root node stands for code reached from START_ADDRESS without a call
+	nodes.push_back(Node{ 0, static_cast<uint16_t>(START_ADDRESS), 0, 0 });
+}
+
+template <unsigned int MemorySize>
+void BasicGuestProfiler<MemorySize>::Call(uint16_t subroutine) {
+	// the tree stops at the 16 entries of the guest stack; deeper calls (the
+	// core wraps sp) are counted so their returns do not pop the tree
+	if (nodes[current].depth >= 16) {
+		++ignoredCalls;
+		return;
+	}
+
+	Settle();
+
+	uint64_t key = (static_cast<uint64_t>(current) << 16) | subroutine;
+	auto found = children.find(key);
+
+	if (found != children.end()) {
+		current = found->second;
+		return;
+	}
+
+	uint32_t node = static_cast<uint32_t>(nodes.size());
+	nodes.push_back(Node{ current, subroutine, static_cast<uint8_t>(nodes[current].depth + 1), 0 });
+	children.emplace(key, node);
+	current = node;
+}
+
+template <unsigned int MemorySize>
+void BasicGuestProfiler<MemorySize>::Return() {
+	if (ignoredCalls) {
+		--ignoredCalls;
+		return;
+	}
+
+	// a return with nothing on the stack stays at the root
+	Settle();
+	current = nodes[current].parent;
+}
+
+static std::string Hex(uint16_t address) {
+	char text[8];
+	snprintf(text, sizeof(text), "0x%03X", address);
+	return text;
+}
+
+template <unsigned int MemorySize>
+void BasicGuestProfiler<MemorySize>::PrintHotSpots(std::ostream& out, size_t count) const {
+	std::vector<uint16_t> addresses;
+	for (unsigned int address = 0; address < MemorySize; ++address) {
+		if (addressCounts[address]) {
+			addresses.push_back(static_cast<uint16_t>(address));
+		}
+	}
+
+	std::sort(addresses.begin(), addresses.end(), [this](uint16_t a, uint16_t b) {
+		return addressCounts[a] > addressCounts[b];
+	});
+
+	out << std::left << std::setw(10) << "address" << std::right << std::setw(16) << "count" << "\n";
+
+	for (size_t i = 0; i < addresses.size() && i < count; ++i) {
+		out << std::left << std::setw(10) << Hex(addresses[i]) << std::right << std::setw(16) << addressCounts[addresses[i]] << "\n";
+	}
+}
+
+template <unsigned int MemorySize>
+void BasicGuestProfiler<MemorySize>::PrintSubroutines(std::ostream& out) const {
+	// nodes are created after their parents, so walking backwards sums each subtree
+	std::vector<uint64_t> total(nodes.size());
+	for (size_t i = nodes.size(); i-- > 0;) {
+		total[i] += Self(i);
+		if (i) {
+			total[nodes[i].parent] += total[i];
+		}
+	}
+
+	std::map<uint16_t, uint64_t> exclusive;
+	std::map<uint16_t, uint64_t> inclusive;
+
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		uint16_t subroutine = nodes[i].subroutine;
+		exclusive[subroutine] += Self(i);
+
+		// recursive paths only count the outermost activation as inclusive time
+		bool outermost = true;
+		for (uint32_t parent = nodes[i].parent; i; parent = nodes[parent].parent) {
+			if (nodes[parent].subroutine == subroutine) {
+				outermost = false;
+				break;
+			}
+			if (parent == 0) {
+				break;
+			}
+		}
+
+		if (outermost) {
+			inclusive[subroutine] += total[i];
+		}
+	}
+
+	std::vector<uint16_t> order;
+	for (const auto& entry : inclusive) {
+		order.push_back(entry.first);
+	}
+	std::sort(order.begin(), order.end(), [&inclusive](uint16_t a, uint16_t b) {
+		return inclusive[a] > inclusive[b];
+	});
+
+	out << std::left << std::setw(12) << "subroutine" << std::right << std::setw(16) << "inclusive" << std::setw(16) << "exclusive" << "\n";
+
+	for (uint16_t subroutine : order) {
+		out << std::left << std::setw(12) << Hex(subroutine)
+			<< std::right << std::setw(16) << inclusive[subroutine]
+			<< std::setw(16) << exclusive[subroutine] << "\n";
+	}
+}
+
+template <unsigned int MemorySize>
+void BasicGuestProfiler<MemorySize>::WriteFolded(std::ostream& out) const {
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (!Self(i)) {
+			continue;
+		}
+
+		std::vector<uint16_t> path;
+		for (uint32_t node = static_cast<uint32_t>(i); ; node = nodes[node].parent) {
+			path.push_back(nodes[node].subroutine);
+			if (node == 0) {
+				break;
+			}
+		}
+
+		for (size_t frame = path.size(); frame-- > 0;) {
+			out << "sub_" << Hex(path[frame]) << (frame ? ";" : " ");
+		}
+		out << Self(i) << "\n";
+	}
+}
+
+template class BasicGuestProfiler<MEMORY_SIZE>;
+template class BasicGuestProfiler<XO_MEMORY_SIZE>;
@@ -0,0 +1,269 @@
+#include "input.h"
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+
+namespace {
+	// cycle of every Ex9E/ExA1 that sees its key in a different state than the previous one did
+	struct KeyProbe {
+		uint64_t cycle{};
+		bool down{};
+		std::vector<uint64_t> changes;
+
+		void Begin(const Chip8& chip8, uint16_t, uint16_t opcode) {
+			uint16_t test = opcode & 0xF0FFu;
+			if (test == 0xE09Eu || test == 0xE0A1u) {
+				bool held = (chip8.keypad >> (chip8.Register((opcode >> 8u) & 0xFu) & 0xFu)) & 1u;
+				if (held != down) {
+					down = held;
+					changes.push_back(cycle);
+				}
+			}
+			++cycle;
+		}
+
+		void End(const Chip8&, uint16_t) {}
+	};
+
+	// wait for key 0 down, then for it to come up again
+	const uint8_t POLL_ROM[] = {
+		0xE0, 0x9E,		// 200: SKP V0
+		0x12, 0x00,		// 202: JP 200
+		0xE0, 0xA1,		// 204: SKNP V0
+		0x12, 0x04,		// 206: JP 204
+		0x12, 0x00,		// 208: JP 200
+	};
+
+	// menu screen: wait for a key, then wait for the next one
+	const uint8_t WAIT_ROM[] = {
+		0xF0, 0x0A,		// 200: LD V0, K
+		0x12, 0x00,		// 202: JP 200
+	};
+
+	// CPU time used by the whole process, user and kernel
+	double ProcessCpuSeconds() {
+#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+		ULARGE_INTEGER k, u;
+		k.LowPart = kernel.dwLowDateTime;
+		k.HighPart = kernel.dwHighDateTime;
+		u.LowPart = user.dwLowDateTime;
+		u.HighPart = user.dwHighDateTime;
+		return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+		return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+	}
+
+	void PrintLatencies(const char* name, std::vector<double> milliseconds) {
+		std::sort(milliseconds.begin(), milliseconds.end());
+		double sum = 0.0;
+		for (double latency : milliseconds) {
+			sum += latency;
+		}
+
+		size_t count = milliseconds.size();
+		std::cout << "  " << name << ": mean " << (count ? sum / count : 0.0)
+			<< " ms, p50 " << (count ? milliseconds[count / 2] : 0.0)
+			<< " ms, p99 " << (count ? milliseconds[count * 99 / 100] : 0.0)
+			<< " ms, max " << (count ? milliseconds.back() : 0.0) << " ms\n";
+	}
+}
+
+namespace {
+	enum class Delivery {
+		BatchStart,			// input at the start of the frame, then emulate ahead
+		PreviousWindow,		// emulate the window that just ended, input at its own cycle
+		CurrentWindow		// emulate ahead, late input moved to the start keeping its spacing (the frontend)
+	};
+
+	const char* DeliveryName(Delivery delivery) {
+		switch (delivery) {
+			case Delivery::BatchStart: return "at batch start (batch emulates the next frame)";
+			case Delivery::PreviousWindow: return "at matching cycle (batch emulates the previous frame)";
+			case Delivery::CurrentWindow: return "at matching cycle, late input moved up (batch emulates the next frame)";
+		}
+		return "";
+	}
+
+	// play events against POLL_ROM for frames frames; the cycle of each change
+	// the ROM observed and the frame whose batch observed it
+	KeyProbe Replay(Delivery delivery, const std::vector<KeyEvent>& events, uint64_t frames, uint64_t frameNanoseconds, uint64_t cycleNanoseconds,
+		uint64_t cycles, std::vector<uint64_t>& batchFrames) {
+		Chip8 chip8;
+		chip8.LoadROM(POLL_ROM);
+		InputRing input;
+		KeyProbe probe;
+		size_t next = 0;
+		batchFrames.clear();
+
+		for (uint64_t frame = 0; frame < frames; ++frame) {
+			// everything that happened before this frame's wall clock time is queued
+			uint64_t now = frame * frameNanoseconds;
+			while (next < events.size() && events[next].timestamp < now) {
+				input.Push(events[next++]);
+			}
+
+			switch (delivery) {
+				case Delivery::BatchStart:
+					DrainInput(chip8, input);
+					for (uint64_t cycle = 0; cycle < cycles; ++cycle) {
+						chip8.Cycle(probe);
+					}
+					break;
+
+				case Delivery::PreviousWindow:
+					if (frame > 0) {
+						RunBatch(chip8, input, now - frameNanoseconds, cycleNanoseconds, cycles, probe);
+					}
+					break;
+
+				case Delivery::CurrentWindow:
+					RunBatch(chip8, input, now, cycleNanoseconds, cycles, probe);
+					break;
+			}
+			batchFrames.resize(probe.changes.size(), frame);
+		}
+
+		return probe;
+	}
+}
+
+int MeasureInputLatency(unsigned int cyclesPerFrame, unsigned int frames) {
+	const uint64_t frameNanoseconds = 1000000000ull / 60;
+	uint64_t cycleNanoseconds = frameNanoseconds / (cyclesPerFrame ? cyclesPerFrame : 1);
+	uint64_t cycles = frameNanoseconds / cycleNanoseconds;
+
+	// alternating press/release of key 0, each held or released for 20-200 ms so none is shorter than a frame
+	std::vector<KeyEvent> events;
+	std::mt19937 generator(0xC8u);
+	std::uniform_int_distribution<uint64_t> gap(20000000, 200000000);
+	for (uint64_t time = gap(generator); time + 2 * frameNanoseconds < frames * frameNanoseconds; time += gap(generator)) {
+		events.push_back({ time, static_cast<uint16_t>(events.size() % 2 == 0 ? 1 : 0) });
+	}
+
+	// 4 ms taps of key 0 at random points of the frame, 100 ms apart
+	std::vector<KeyEvent> taps;
+	std::uniform_int_distribution<uint64_t> phase(0, frameNanoseconds);
+	for (uint64_t time = 100000000; time + 100000000 < frames * frameNanoseconds; time += 100000000) {
+		uint64_t press = time + phase(generator);
+		taps.push_back({ press, 1 });
+		taps.push_back({ press + 4000000, 0 });
+	}
+
+	std::cout << "input latency, " << events.size() << " key events over " << frames << " frames, "
+		<< cycles << " cycles/frame\n";
+
+	for (Delivery delivery : { Delivery::BatchStart, Delivery::PreviousWindow, Delivery::CurrentWindow }) {
+		std::vector<uint64_t> batchFrames;
+		KeyProbe probe = Replay(delivery, events, frames, frameNanoseconds, cycleNanoseconds, cycles, batchFrames);
+
+		std::vector<double> emulated, delivered;
+		size_t matched = std::min(probe.changes.size(), events.size());
+		for (size_t k = 0; k < matched; ++k) {
+			// the previous window batch emulates frame window n - 1 in frame n, the others window n;
+			// either way window n is instructions n * cycles onwards
+			uint64_t observed = probe.changes[k] / cycles * frameNanoseconds + probe.changes[k] % cycles * cycleNanoseconds;
+			emulated.push_back((observed - events[k].timestamp) / 1e6);
+			delivered.push_back((batchFrames[k] * frameNanoseconds - events[k].timestamp) / 1e6);
+		}
+
+		std::cout << DeliveryName(delivery) << "\n";
+		PrintLatencies("emulated time to Ex9E/ExA1", emulated);
+		PrintLatencies("wall time to executing batch", delivered);
+		if (matched != events.size()) {
+			std::cout << "  " << events.size() - matched << " event(s) never observed\n";
+		}
+
+		// a seen tap is a press and a release observed
+		KeyProbe tapProbe = Replay(delivery, taps, frames, frameNanoseconds, cycleNanoseconds, cycles, batchFrames);
+		std::cout << "  4 ms taps seen: " << tapProbe.changes.size() / 2 << " of " << taps.size() / 2 << "\n";
+	}
+
+	return 0;
+}
+
+int MeasureIdleCpu(unsigned int cyclesPerFrame, unsigned int seconds) {
+	const uint64_t frameNanoseconds = 1000000000ull / 60;
+	uint64_t cycleNanoseconds = frameNanoseconds / (cyclesPerFrame ? cyclesPerFrame : 1);
+	uint64_t duration = seconds * 1000000000ull;
+
+	// a 100 ms key tap every second, relative to the start of the run
+	std::vector<KeyEvent> events;
+	for (uint64_t time = 500000000; time < duration; time += 1000000000) {
+		events.push_back({ time, 1 });
+		events.push_back({ time + 100000000, 0 });
+	}
+
+	std::cout << "idle CPU on Fx0A, " << seconds << " s per loop, a key tap every second\n";
+
+	for (bool sleeping : { false, true }) {
+		Chip8 chip8;
+		chip8.LoadROM(WAIT_ROM);
+		InputRing input;
+		NullProfiler profiler;
+		size_t next = 0;
+		uint64_t executed = 0;
+		uint64_t iterations = 0;
+
+		double cpuStart = ProcessCpuSeconds();
+		uint64_t start = InputTimestamp();
+		uint64_t emulatedTime = start;
+
+		for (uint64_t now = start; now - start < duration; now = InputTimestamp(), ++iterations) {
+			while (next < events.size() && start + events[next].timestamp <= now) {
+				input.Push({ start + events[next].timestamp, events[next].keypad });
+				++next;
+			}
+
+			if (!sleeping) {
+				// the previous frontend loop: poll, and one instruction whenever its time has come
+				DrainInput(chip8, input);
+				if (now - emulatedTime > cycleNanoseconds) {
+					emulatedTime = now;
+					chip8.Cycle(profiler);
+					++executed;
+				}
+				continue;
+			}
+
+			if (now < emulatedTime) {
+				// the frontend sleeps in SDL_WaitEventTimeout, here the next event is known
+				uint64_t wake = emulatedTime;
+				if (chip8.Idle() && input.Empty()) {
+					wake = next < events.size() ? start + events[next].timestamp : start + duration;
+				}
+				std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(wake, start + duration) - now));
+				continue;
+			}
+
+			if (now - emulatedTime > 4 * frameNanoseconds) {
+				emulatedTime = now;
+			}
+			uint64_t cycles = (now + frameNanoseconds - emulatedTime) / cycleNanoseconds;
+			RunBatch(chip8, input, emulatedTime, cycleNanoseconds, cycles, profiler);
+			emulatedTime += cycles * cycleNanoseconds;
+			executed += cycles;
+		}
+
+		double cpu = ProcessCpuSeconds() - cpuStart;
+		std::cout << (sleeping ? "sleeping until a frame or key is due" : "polling every instruction (previous loop)")
+			<< ": CPU " << cpu << " s (" << cpu * 100.0 / seconds << "% of one core)"
+			<< ", loop iterations " << iterations
+			<< ", cycles " << executed << "\n";
+	}
+
+	return 0;
+}
@@ -1,47 +1,290 @@
 #include "main.h"
 
+// the SDL frontend on the machine of a quirk profile; the GDB server only speaks Chip8
+template <typename Machine>
+int RunFrontend(const char* romFilename, int videoScale, int cycleDelay) {
+	// 64 KB of XO-CHIP memory does not belong on the stack
+	std::unique_ptr<Machine> machine = std::make_unique<Machine>();
+	Machine& chip8 = *machine;
+	LoadResult loaded = chip8.LoadROM(romFilename);
 
-int main(int argc, char** argv) {
-	/*if (argc != 4) {
-		std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
+	if (loaded != LoadResult::Ok) {
+		std::cerr << "Cannot load " << romFilename << ": " << LoadResultMessage(loaded) << "\n";
 		std::exit(EXIT_FAILURE);
 	}
 
-	int videoScale = std::stoi(argv[1]);
-	int cycleDelay = std::stoi(argv[2]);
-	char const* romFilename = argv[3];*/
+	Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, HIRES_WIDTH, HIRES_HEIGHT);
 
-	int videoScale = 10;
-	int cycleDelay = 1;
-	char const* romFilename = ".\\ROMS\\test_opcode.ch8";
-	//char const* romFilename = ".\\ROMS\\Tetris.ch8";
+	// the texture is always high resolution, low resolution pixels are doubled into it
+	static uint32_t pixels[HIRES_WIDTH * HIRES_HEIGHT];
+	int videoPitch = sizeof(pixels[0]) * HIRES_WIDTH;
 
+	// optional, the built-in layout stays for anything it does not mention
+	platform.keyMap.Load("keymap.cfg");
 
-	Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH, VIDEO_HEIGHT);
+#if defined(CHIP8_PROFILE)
+	OpcodeProfiler<CHIP8_PROFILE_TICKS> profiler;
+#elif defined(CHIP8_GUEST_PROFILE)
+	BasicGuestProfiler<Machine::MEMORY_MASK + 1> profiler;
+#elif defined(CHIP8_TRACE)
+	Tracer profiler("chip8.trace");
+#else
+	NullProfiler profiler;
+#endif
 
-	Chip8 chip8;
-	chip8.LoadROM(romFilename);
+	FrameTelemetry telemetry;
 
-	int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH;
+#if defined(CHIP8_GDB_PORT)
+	constexpr bool debuggable = std::is_same_v<Machine, Chip8>;
+	GdbServer gdbServer;
+	if constexpr (debuggable) {
+		if (!gdbServer.Listen(CHIP8_GDB_PORT)) {
+			std::cerr << "Cannot listen on port " << CHIP8_GDB_PORT << "\n";
+		}
+	}
+#endif
 
-	auto lastCycleTime = std::chrono::high_resolution_clock::now();
+	// each batch emulates the frame ahead of the clock, so what it draws is
+	// shown right away; key events are stamped when SDL sees them, and those
+	// that came in while the last frame was shown start the batch with their
+	// spacing kept (see RunBatch)
+	InputRing input;
+	const uint64_t frameNanoseconds = 1000000000ull / 60;
+	const uint64_t cycleNanoseconds = static_cast<uint64_t>(cycleDelay) * 1000000;
+	uint64_t emulatedTime = InputTimestamp();	// emulated up to here
 	bool quit = false;
 
+#if defined(CHIP8_GDB_PORT)
+	// the socket is only serviced between frames
+	const int idleTimeout = 1000 / 60;
+#else
+	const int idleTimeout = -1;
+#endif
+
 	while (!quit) {
-		quit = platform.ProcessInput(chip8.keypad);
+		uint64_t now = InputTimestamp();
+		if (now < emulatedTime) {
+			// sleep until the emulated frame has been shown, or while Fx0A
+			// waits with the timers stopped until an event arrives: frames in
+			// between would not change anything
+			int timeout = static_cast<int>((emulatedTime - now + 999999) / 1000000);
+			if (chip8.Idle() && input.Empty()) {
+				timeout = idleTimeout;
+			}
+			quit = platform.WaitInput(input, timeout);
+			continue;
+		}
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
-	
-		if (dt > cycleDelay)
-		{
-			lastCycleTime = currentTime;
+		quit = platform.ProcessInput(input);
 
-			chip8.Cycle();
+		// after a stall (window drag, breakpoint, Idle) drop the backlog instead of racing through it
+		if (now - emulatedTime > 4 * frameNanoseconds) {
+			emulatedTime = now;
+		}
+		uint64_t cycles = (now + frameNanoseconds - emulatedTime) / cycleNanoseconds;
 
-			platform.Update(chip8.video, videoPitch);
+		auto emulateStart = FrameTelemetry::Clock::now();
+#if defined(CHIP8_GDB_PORT)
+		if constexpr (debuggable) {
+			gdbServer.Poll(chip8);
 		}
+		if (!gdbServer.Attached()) {
+			RunBatch(chip8, input, emulatedTime, cycleNanoseconds, cycles, profiler);
+		}
+		else if constexpr (debuggable) {
+			DrainInput(chip8, input);
+			if (!gdbServer.Halted()) {
+				gdbServer.Run(chip8, cycles);
+			}
+		}
+#else
+		RunBatch(chip8, input, emulatedTime, cycleNanoseconds, cycles, profiler);
+#endif
+		emulatedTime += cycles * cycleNanoseconds;
+		telemetry.Record(FrameTelemetry::EMULATE, emulateStart, FrameTelemetry::Clock::now());
+
+		chip8.ExpandVideo(pixels);
+		platform.Update(pixels, videoPitch, &telemetry);
 	}
 
+	telemetry.WriteCsv("frame_times.csv");
+
+#if defined(CHIP8_PROFILE)
+	profiler.Print(std::cout);
+	profiler.WriteJson("opcode_profile.json");
+#elif defined(CHIP8_GUEST_PROFILE)
+	profiler.PrintHotSpots(std::cout, 20);
+	profiler.PrintSubroutines(std::cout);
+	std::ofstream folded("guest_profile.folded");
+	profiler.WriteFolded(folded);
+#endif
+
 	return 0;
-}
\ No newline at end of file
+}
+
+
+int main(int argc, char** argv) {
+	// headless tools
+	if (argc >= 2 && std::string(argv[1]) == "--sessions") {
+		if (argc < 5) {
+			std::cerr << "Usage: " << argv[0] << " --sessions <ROM> <Count> <Frames> [Threads]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return MeasureSessions(argv[2], std::stoul(argv[3]), std::stoul(argv[4]), argc > 5 ? std::stoul(argv[5]) : 1);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--batch-diversity") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --batch-diversity <ROM> [Instances] [Steps]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return CheckBatchDiversity(argv[2], argc > 3 ? std::stoul(argv[3]) : 8, argc > 4 ? std::stoul(argv[4]) : 200);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--decode-trace") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --decode-trace <Trace>\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return DecodeTrace(argv[2], std::cout);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--bench") {
+		return RunBenchmarks(argc > 2 ? argv[2] : nullptr, argc > 3 ? argv[3] : "ROMS");
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--bench-compare") {
+		if (argc < 4) {
+			std::cerr << "Usage: " << argv[0] << " --bench-compare <Baseline.json> <Current.json> [Threshold%]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return CompareBenchmarks(argv[2], argv[3], argc > 4 ? std::stod(argv[4]) : 5.0);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--build-store") {
+		if (argc < 4) {
+			std::cerr << "Usage: " << argv[0] << " --build-store <RomDir> <Index> [CyclesPerFrame] [BootFrames]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return BuildRomStore(argv[2], argv[3], argc > 4 ? std::stoul(argv[4]) : 10, argc > 5 ? std::stoul(argv[5]) : 60);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--store-startup") {
+		if (argc < 4) {
+			std::cerr << "Usage: " << argv[0] << " --store-startup <Index> <RomDir> [Instances]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return MeasureRomStartup(argv[2], argv[3], argc > 4 ? std::stoul(argv[4]) : 1000);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--analyze") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --analyze <ROM> [dot]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return AnalyzeRomFile(argv[2], argc > 3 && std::string(argv[3]) == "dot", std::cout);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--recompile") {
+		if (argc < 4) {
+			std::cerr << "Usage: " << argv[0] << " --recompile <ROM> <Output.cpp> [Name]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return RecompileRom(argv[2], argv[3], argc > 4 ? argv[4] : argv[2]);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--native-compare") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --native-compare <ROM> [Frames] [CyclesPerFrame]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return CompareNative(argv[2], argc > 3 ? std::stoul(argv[3]) : 100000, argc > 4 ? std::stoul(argv[4]) : 10);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--debug") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --debug <ROM> [CyclesPerFrame]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return RunDebugConsole(argv[2], argc > 3 ? std::stoul(argv[3]) : 10, std::cin, std::cout);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--gdb") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --gdb <ROM> [Port] [CyclesPerFrame]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return RunGdbServer(argv[2], static_cast<uint16_t>(argc > 3 ? std::stoul(argv[3]) : 2159), argc > 4 ? std::stoul(argv[4]) : 10);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--input-latency") {
+		return MeasureInputLatency(argc > 2 ? std::stoul(argv[2]) : 10, argc > 3 ? std::stoul(argv[3]) : 100000);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--fuzz") {
+		FuzzEngine engine = FuzzEngine::Reference;
+		if (argc > 2 && !ParseFuzzEngine(argv[2], engine)) {
+			std::cerr << "Usage: " << argv[0] << " --fuzz [reference|batch|snapshot] [Cases] [Threads] [Seed] [CheckInterval]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return RunFuzzer(engine, argc > 3 ? std::stoull(argv[3]) : 100000, argc > 4 ? std::stoul(argv[4]) : 0,
+			argc > 5 ? std::stoull(argv[5]) : 1, argc > 6 ? std::stoul(argv[6]) : 64);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--regress") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --regress <Manifest> [Threads] [DumpDir]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return RunRegression(argv[2], argc > 3 ? std::stoul(argv[3]) : 0, argc > 4 ? argv[4] : "regression_failures");
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--regress-record") {
+		if (argc < 3) {
+			std::cerr << "Usage: " << argv[0] << " --regress-record <Manifest>\n";
+			std::exit(EXIT_FAILURE);
+		}
+		return RecordRegression(argv[2], std::cout);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--search") {
+		SearchConfig config;
+		if (argc < 4 || !ParseSearchTerms(argv[3], config.score, config.goal) || (argc > 6 && !ParseSearchKeys(argv[6], config.actions))) {
+			std::cerr << "Usage: " << argv[0] << " --search <ROM> <Address:Weight|Address=Value,...> [Depth] [Width] [Keys] [Threads] [Movie]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		config.quirks = SelectQuirkProfile(argv[2], nullptr);
+		config.maxDepth = argc > 4 ? std::stoul(argv[4]) : config.maxDepth;
+		config.width = argc > 5 ? std::stoul(argv[5]) : config.width;
+		config.threads = argc > 7 ? std::stoul(argv[7]) : 0;
+		return RunSearchDriver(argv[2], config, argc > 8 ? argv[8] : "search.movie", std::cout);
+	}
+
+	if (argc >= 2 && std::string(argv[1]) == "--idle-cpu") {
+		return MeasureIdleCpu(argc > 2 ? std::stoul(argv[2]) : 10, argc > 3 ? std::stoul(argv[3]) : 5);
+	}
+
+	/*if (argc != 4) {
+		std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	int videoScale = std::stoi(argv[1]);
+	int cycleDelay = std::stoi(argv[2]);
+	char const* romFilename = argv[3];*/
+
+	int videoScale = 10;
+	int cycleDelay = 1;
+	char const* romFilename = ".\\ROMS\\test_opcode.ch8";
+	//char const* romFilename = ".\\ROMS\\Tetris.ch8";
+
+
+	// optional like keymap.cfg: a ROM store built with --build-store names the quirks of the ROMs it knows
+	RomStore store;
+	bool haveStore = store.Open("roms.idx");
+	QuirkProfile quirks = SelectQuirkProfile(romFilename, haveStore ? &store : nullptr);
+
+	return VisitQuirkProfile(quirks, [&]<typename Machine>() {
+		return RunFrontend<Machine>(romFilename, videoScale, cycleDelay);
+	});
+}
@@ -0,0 +1,145 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+bool MappedFile::OpenRead(const char* filename) {
+	return Map(filename, 0, false);
+}
+
+bool MappedFile::OpenWrite(const char* filename, size_t size) {
+	return Map(filename, size, true);
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Map(const char* filename, size_t newSize, bool writable) {
+	Close();
+
+	file = CreateFileA(filename, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ,
+		nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		return false;
+	}
+
+	if (writable) {
+		LARGE_INTEGER length;
+		length.QuadPart = static_cast<LONGLONG>(newSize);
+		SetFilePointerEx(file, length, nullptr, FILE_BEGIN);
+		SetEndOfFile(file);
+		size = newSize;
+	}
+	else {
+		LARGE_INTEGER length;
+		GetFileSizeEx(file, &length);
+		size = static_cast<size_t>(length.QuadPart);
+	}
+
+	opened = true;
+
+	// empty files cannot be mapped, they stay open with no data
+	if (size == 0) {
+		return true;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		Close();
+		return false;
+	}
+
+	data = static_cast<uint8_t*>(MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0));
+	if (!data) {
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+
+	data = nullptr;
+	mapping = nullptr;
+	file = nullptr;
+	size = 0;
+	opened = false;
+}
+
+#else
+
+bool MappedFile::Map(const char* filename, size_t newSize, bool writable) {
+	Close();
+
+	file = open(filename, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (file < 0) {
+		return false;
+	}
+
+	if (writable) {
+		if (ftruncate(file, static_cast<off_t>(newSize)) != 0) {
+			Close();
+			return false;
+		}
+		size = newSize;
+	}
+	else {
+		struct stat info;
+		fstat(file, &info);
+		size = static_cast<size_t>(info.st_size);
+	}
+
+	opened = true;
+
+	// empty files cannot be mapped, they stay open with no data
+	if (size == 0) {
+		return true;
+	}
+
+	void* mapped = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	if (mapped == MAP_FAILED) {
+		Close();
+		return false;
+	}
+
+	data = static_cast<uint8_t*>(mapped);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) {
+		munmap(data, size);
+	}
+	if (file >= 0) {
+		close(file);
+	}
+
+	data = nullptr;
+	file = -1;
+	size = 0;
+	opened = false;
+}
+
+#endif
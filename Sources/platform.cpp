@@ -1,8 +1,93 @@
 #include "platform.h"
 
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+
+KeyMap::KeyMap() {
+	static const SDL_Scancode keys[16] = {
+		SDL_SCANCODE_X, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3,
+		SDL_SCANCODE_Q, SDL_SCANCODE_W, SDL_SCANCODE_E, SDL_SCANCODE_A,
+		SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Z, SDL_SCANCODE_C,
+		SDL_SCANCODE_4, SDL_SCANCODE_R, SDL_SCANCODE_F, SDL_SCANCODE_V
+	};
+
+	memset(entries, KEYMAP_NONE, sizeof(entries));
+	for (int8_t key = 0; key < 16; ++key) {
+		entries[keys[key]] = key;
+	}
+	entries[SDL_SCANCODE_ESCAPE] = KEYMAP_QUIT;
+	entries[SDL_SCANCODE_F1] = KEYMAP_OVERLAY;
+
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_DPAD_UP] = 0x2;
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_DPAD_LEFT] = 0x4;
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_DPAD_RIGHT] = 0x6;
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_DPAD_DOWN] = 0x8;
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_A] = 0x5;
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_B] = 0x0;
+	entries[KEYMAP_GAMEPAD_BASE + SDL_CONTROLLER_BUTTON_BACK] = KEYMAP_QUIT;
+}
+
+bool KeyMap::Load(const char* filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t split = line.find_last_of(" \t");
+		if (line.empty() || line[0] == '#' || split == std::string::npos) {
+			continue;
+		}
+
+		std::string key = line.substr(0, line.find_last_not_of(" \t", split) + 1);
+		std::string target = line.substr(split + 1);
+
+		int index = -1;
+		if (key.rfind("pad:", 0) == 0) {
+			SDL_GameControllerButton button = SDL_GameControllerGetButtonFromString(key.c_str() + 4);
+			if (button != SDL_CONTROLLER_BUTTON_INVALID) {
+				index = KEYMAP_GAMEPAD_BASE + button;
+			}
+		}
+		else {
+			SDL_Scancode scancode = SDL_GetScancodeFromName(key.c_str());
+			if (scancode != SDL_SCANCODE_UNKNOWN) {
+				index = scancode;
+			}
+		}
+
+		if (index < 0) {
+			SDL_Log("keymap: unknown key \"%s\"", key.c_str());
+			continue;
+		}
+
+		if (target == "quit") {
+			entries[index] = KEYMAP_QUIT;
+		}
+		else if (target == "overlay") {
+			entries[index] = KEYMAP_OVERLAY;
+		}
+		else if (target == "none") {
+			entries[index] = KEYMAP_NONE;
+		}
+		else if (target.size() == 1 && isxdigit(static_cast<unsigned char>(target[0]))) {
+			entries[index] = static_cast<int8_t>(std::stoi(target, nullptr, 16));
+		}
+		else {
+			SDL_Log("keymap: unknown target \"%s\"", target.c_str());
+		}
+	}
+
+	return true;
+}
+
 
 Platform::Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight) {
-	SDL_Init(SDL_INIT_VIDEO);
+	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
 
 	window = SDL_CreateWindow(title, 100, SDL_WINDOWPOS_CENTERED, windowWidth, windowHeight, SDL_WINDOW_SHOWN);
 
@@ -18,166 +103,151 @@ Platform::~Platform() {
 	SDL_Quit();
 }
 
-void Platform::Update(void const* buffer, int pitch) {
+void Platform::Update(void const* buffer, int pitch, FrameTelemetry* telemetry) {
+	auto uploadStart = FrameTelemetry::Clock::now();
 	SDL_UpdateTexture(texture, nullptr, buffer, pitch);
+	auto uploadEnd = FrameTelemetry::Clock::now();
+
 	SDL_RenderClear(renderer);
 	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-	SDL_RenderPresent(renderer);
-}
 
-bool Platform::ProcessInput(uint8_t* keys)
-{
-	bool quit = false;
+	if (telemetry && showOverlay) {
+		DrawOverlay(*telemetry);
+	}
 
-	SDL_Event event;
+	auto presentStart = FrameTelemetry::Clock::now();
+	SDL_RenderPresent(renderer);
+	auto presentEnd = FrameTelemetry::Clock::now();
 
-	while (SDL_PollEvent(&event)) {
-		switch (event.type) {
-			case SDL_QUIT : {
-				quit = true;
-			}break;
+	if (telemetry) {
+		telemetry->Record(FrameTelemetry::UPLOAD, uploadStart, uploadEnd);
+		telemetry->Record(FrameTelemetry::PRESENT, presentStart, presentEnd);
+		telemetry->EndFrame();
+	}
+}
 
-			case SDL_KEYDOWN: {
-				switch (event.key.keysym.sym) {
-					case SDLK_ESCAPE: {
-						quit = true;
-					}break;
+void Platform::DrawOverlay(const FrameTelemetry& telemetry) {
+	static const Uint8 colors[FrameTelemetry::PHASE_COUNT][3] = { { 0, 200, 0 }, { 230, 200, 0 }, { 220, 0, 0 } };
 
-					case SDLK_x: {
-						keys[0] = 1;
-					}break;
+	int width, height;
+	SDL_GetRendererOutputSize(renderer, &width, &height);
 
-					case SDLK_1: {
-						keys[1] = 1;
-					}break;
+	unsigned int frames = FrameTelemetry::RECENT_FRAMES;
+	if (telemetry.Frames() < frames) {
+		frames = static_cast<unsigned int>(telemetry.Frames());
+	}
 
-					case SDLK_2: {
-						keys[2] = 1;
-					}break;
+	// scale so the slowest recent frame fills the overlay height
+	uint64_t slowest = 1;
+	for (unsigned int i = 1; i <= frames; ++i) {
+		uint64_t total = 0;
+		for (unsigned int phase = 0; phase < FrameTelemetry::PHASE_COUNT; ++phase) {
+			total += telemetry.Recent(static_cast<FrameTelemetry::Phase>(phase), i);
+		}
+		if (total > slowest) {
+			slowest = total;
+		}
+	}
 
-					case SDLK_3: {
-						keys[3] = 1;
-					}break;
+	int overlayHeight = height / 3;
+	int barWidth = width / FrameTelemetry::RECENT_FRAMES > 0 ? width / FrameTelemetry::RECENT_FRAMES : 1;
 
-					case SDLK_q: {
-						keys[4] = 1;
-					}break;
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+	SDL_Rect background{ 0, height - overlayHeight, width, overlayHeight };
+	SDL_RenderFillRect(renderer, &background);
 
-					case SDLK_w: {
-						keys[5] = 1;
-					}break;
+	// newest frame on the right
+	for (unsigned int i = 1; i <= frames; ++i) {
+		int x = width - static_cast<int>(i) * barWidth;
+		int y = height;
 
-					case SDLK_e: {
-						keys[6] = 1;
-					}break;
+		for (unsigned int phase = 0; phase < FrameTelemetry::PHASE_COUNT; ++phase) {
+			uint32_t nanoseconds = telemetry.Recent(static_cast<FrameTelemetry::Phase>(phase), i);
+			int barHeight = static_cast<int>(nanoseconds * overlayHeight / slowest);
 
-					case SDLK_a: {
-						keys[7] = 1;
-					}break;
+			SDL_SetRenderDrawColor(renderer, colors[phase][0], colors[phase][1], colors[phase][2], 255);
+			SDL_Rect bar{ x, y - barHeight, barWidth, barHeight };
+			SDL_RenderFillRect(renderer, &bar);
+			y -= barHeight;
+		}
+	}
 
-					case SDLK_s: {
-						keys[8] = 1;
-					}break;
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+}
 
-					case SDLK_d: {
-						keys[9] = 1;
-					}break;
+bool Platform::ProcessInput(uint16_t& keys)
+{
+	return PollEvents(keys, nullptr, 0);
+}
 
-					case SDLK_z: {
-						keys[0xA] = 1;
-					}break;
+bool Platform::ProcessInput(InputRing& input)
+{
+	return PollEvents(heldKeys, &input, 0);
+}
 
-					case SDLK_c: {
-						keys[0xB] = 1;
-					}break;
+bool Platform::WaitInput(InputRing& input, int timeout)
+{
+	return PollEvents(heldKeys, &input, timeout);
+}
 
-					case SDLK_4: {
-						keys[0xC] = 1;
-					}break;
+bool Platform::PollEvents(uint16_t& keys, InputRing* input, int timeout)
+{
+	bool quit = false;
 
-					case SDLK_r: {
-						keys[0xD] = 1;
-					}break;
+	SDL_Event event;
 
-					case SDLK_f: {
-						keys[0xE] = 1;
-					}break;
+	// block for the first event if asked to, then drain the rest of the queue
+	bool received = timeout != 0 ? SDL_WaitEventTimeout(&event, timeout) : SDL_PollEvent(&event);
 
-					case SDLK_v: {
-						keys[0xF] = 1;
-					}break;
-				}
-			} break;
+	for (; received; received = SDL_PollEvent(&event)) {
+		int8_t target = KEYMAP_NONE;
+		bool pressed = false;
 
+		switch (event.type) {
+			case SDL_QUIT: {
+				quit = true;
+			}break;
 
+			case SDL_KEYDOWN:
 			case SDL_KEYUP: {
-				switch (event.key.keysym.sym) {
-					case SDLK_x: {
-						keys[0] = 0;
-					}break;
-
-					case SDLK_1: {
-						keys[1] = 0;
-					}break;
-
-					case SDLK_2: {
-						keys[2] = 0;
-					}break;
-
-					case SDLK_3: {
-						keys[3] = 0;
-					}break;
-
-					case SDLK_q: {
-						keys[4] = 0;
-					}break;
-
-					case SDLK_w: {
-						keys[5] = 0;
-					}break;
-
-					case SDLK_e: {
-						keys[6] = 0;
-					}break;
-
-					case SDLK_a: {
-						keys[7] = 0;
-					}break;
-
-					case SDLK_s: {
-						keys[8] = 0;
-					}break;
-
-					case SDLK_d: {
-						keys[9] = 0;
-					}break;
-
-					case SDLK_z: {
-						keys[0xA] = 0;
-					}break;
-
-					case SDLK_c: {
-						keys[0xB] = 0;
-					}break;
-
-					case SDLK_4: {
-						keys[0xC] = 0;
-					}break;
-
-					case SDLK_r: {
-						keys[0xD] = 0;
-					}break;
-
-					case SDLK_f: {
-						keys[0xE] = 0;
-					}break;
-
-					case SDLK_v: {
-						keys[0xF] = 0;
-					}break;
+				if (event.key.repeat) {
+					continue;
 				}
-			} break;
+				target = keyMap.entries[event.key.keysym.scancode];
+				pressed = event.type == SDL_KEYDOWN;
+			}break;
+
+			case SDL_CONTROLLERBUTTONDOWN:
+			case SDL_CONTROLLERBUTTONUP: {
+				target = keyMap.entries[KEYMAP_GAMEPAD_BASE + event.cbutton.button];
+				pressed = event.type == SDL_CONTROLLERBUTTONDOWN;
+			}break;
+
+			case SDL_CONTROLLERDEVICEADDED: {
+				SDL_GameControllerOpen(event.cdevice.which);
+			}break;
+		}
+
+		if (target >= 0) {
+			uint16_t bit = static_cast<uint16_t>(1u << target);
+			uint16_t changed = pressed ? keys | bit : keys & ~bit;
+			if (changed != keys && input) {
+				// SDL stamps events in milliseconds of SDL_GetTicks, shift them onto the InputTimestamp clock
+				uint64_t now = InputTimestamp();
+				uint32_t ticks = SDL_GetTicks();
+				uint32_t elapsed = SDL_TICKS_PASSED(ticks, event.common.timestamp) ? ticks - event.common.timestamp : 0;
+				uint64_t age = static_cast<uint64_t>(elapsed) * 1000000;
+				input->Push({ age < now ? now - age : 0, changed });
+			}
+			keys = changed;
 		}
-	} 	
+		else if (pressed && target == KEYMAP_QUIT) {
+			quit = true;
+		}
+		else if (pressed && target == KEYMAP_OVERLAY) {
+			showOverlay = !showOverlay;
+		}
+	}
 	return quit;
-}
\ No newline at end of file
+}
@@ -0,0 +1,95 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+
+static const char* const handlerNames[HANDLER_COUNT] = {
+	"OP_NULL",
+	"OP_00E0", "OP_00EE", "OP_1nnn", "OP_2nnn", "OP_3xkk", "OP_4xkk", "OP_5xy0",
+	"OP_6xkk", "OP_7xkk", "OP_8xy0", "OP_8xy1", "OP_8xy2", "OP_8xy3", "OP_8xy4",
+	"OP_8xy5", "OP_8xy6", "OP_8xy7", "OP_8xyE", "OP_9xy0", "OP_Annn", "OP_Bnnn",
+	"OP_Cxkk", "OP_Dxyn", "OP_Ex9E", "OP_ExA1", "OP_Fx07", "OP_Fx0A", "OP_Fx15",
+	"OP_Fx18", "OP_Fx1E", "OP_Fx29", "OP_Fx33", "OP_Fx55", "OP_Fx65",
+	"OP_00Cn", "OP_00FB", "OP_00FC", "OP_00FD", "OP_00FE", "OP_00FF", "OP_Fx30",
+	"OP_Fx75", "OP_Fx85",
+	"OP_5xy2", "OP_5xy3", "OP_F000", "OP_Fn01", "OP_F002", "OP_Fx3A"
+};
+
+const char* HandlerName(OpcodeHandler handler) {
+	return handler < HANDLER_COUNT ? handlerNames[handler] : "?";
+}
+
+// handlers that ran, most executed first
+static void SortedHandlers(const OpcodeProfile& profile, OpcodeHandler* order, size_t& used) {
+	used = 0;
+	for (uint8_t i = 0; i < HANDLER_COUNT; ++i) {
+		if (profile.counts[i]) {
+			order[used++] = static_cast<OpcodeHandler>(i);
+		}
+	}
+
+	std::sort(order, order + used, [&profile](OpcodeHandler a, OpcodeHandler b) {
+		return profile.counts[a] > profile.counts[b];
+	});
+}
+
+void OpcodeProfile::Print(std::ostream& out) const {
+	OpcodeHandler order[HANDLER_COUNT];
+	size_t used;
+	SortedHandlers(*this, order, used);
+
+	uint64_t total = 0;
+	for (uint64_t count : counts) {
+		total += count;
+	}
+
+	out << std::left << std::setw(10) << "handler" << std::right << std::setw(16) << "count" << std::setw(9) << "%";
+	if (timed) {
+		out << std::setw(16) << "ticks" << std::setw(12) << "ticks/op";
+	}
+	out << "\n";
+
+	for (size_t i = 0; i < used; ++i) {
+		OpcodeHandler handler = order[i];
+
+		out << std::left << std::setw(10) << HandlerName(handler)
+			<< std::right << std::setw(16) << counts[handler]
+			<< std::setw(9) << std::fixed << std::setprecision(2) << 100.0 * counts[handler] / total;
+		if (timed) {
+			out << std::setw(16) << ticks[handler]
+				<< std::setw(12) << std::setprecision(1) << static_cast<double>(ticks[handler]) / counts[handler];
+		}
+		out << "\n";
+	}
+}
+
+void OpcodeProfile::WriteJson(std::ostream& out) const {
+	OpcodeHandler order[HANDLER_COUNT];
+	size_t used;
+	SortedHandlers(*this, order, used);
+
+	out << "{\n  \"timed\": " << (timed ? "true" : "false") << ",\n  \"handlers\": [";
+	for (size_t i = 0; i < used; ++i) {
+		OpcodeHandler handler = order[i];
+
+		out << (i ? "," : "") << "\n    { \"name\": \"" << HandlerName(handler) << "\", \"count\": " << counts[handler];
+		if (timed) {
+			out << ", \"ticks\": " << ticks[handler];
+		}
+		out << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+bool OpcodeProfile::WriteJson(const char* filename) const {
+	std::ofstream file(filename);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	WriteJson(file);
+	return true;
+}
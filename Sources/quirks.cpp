@@ -0,0 +1,33 @@
+#include "quirks.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+const char* QuirkProfileName(QuirkProfile profile) {
+	switch (profile) {
+		case QuirkProfile::Default: return "default";
+		case QuirkProfile::Vip: return "vip";
+		case QuirkProfile::Schip: return "schip";
+		case QuirkProfile::XoChip: return "xochip";
+		case QuirkProfile::Count: break;
+	}
+	return "unknown";
+}
+
+bool ParseQuirkProfile(const char* text, QuirkProfile& profile) {
+	for (uint32_t id = 0; id < static_cast<uint32_t>(QuirkProfile::Count); ++id) {
+		if (strcmp(text, QuirkProfileName(static_cast<QuirkProfile>(id))) == 0) {
+			profile = static_cast<QuirkProfile>(id);
+			return true;
+		}
+	}
+
+	char* end = nullptr;
+	unsigned long id = strtoul(text, &end, 10);
+	if (end == text || *end != '\0' || id >= static_cast<unsigned long>(QuirkProfile::Count)) {
+		return false;
+	}
+	profile = static_cast<QuirkProfile>(id);
+	return true;
+}
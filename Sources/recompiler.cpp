@@ -0,0 +1,347 @@
+#include "recompiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "analyzer.h"
+#include "disassembler.h"
+#include "profiler.h"
+#include "rom_store.h"
+
+
+static std::vector<NativeRom>& NativeRoms() {
+	static std::vector<NativeRom> roms;
+	return roms;
+}
+
+bool RegisterNativeRom(const NativeRom& rom) {
+	NativeRoms().push_back(rom);
+	return true;
+}
+
+const NativeRom* FindNativeRom(uint64_t hash) {
+	for (const NativeRom& rom : NativeRoms()) {
+		if (rom.hash == hash) {
+			return &rom;
+		}
+	}
+	return nullptr;
+}
+
+
+void NativeRunner::Run(uint64_t cycles) {
+	while (cycles) {
+		if (!disabled) {
+			cycles -= rom.entry(ctx, cycles);
+
+			if (ctx.modified) {
+				ctx.modified = false;
+				disabled = true;
+			}
+
+			if (!cycles) {
+				break;
+			}
+		}
+
+		// one instruction the compiled code could not run
+		uint16_t pc = chip8.ProgramCounter();
+		uint16_t opcode = (chip8.ReadMemory(pc) << 8u) | chip8.ReadMemory(pc + 1);
+
+		chip8.Cycle();
+		--cycles;
+
+		if (!disabled && ((opcode & 0xF0FFu) == 0xF033u || (opcode & 0xF0FFu) == 0xF055u) && !CodeIntact()) {
+			disabled = true;
+		}
+	}
+}
+
+bool NativeRunner::CodeIntact() const {
+	for (unsigned int i = 0; i < rom.size; ++i) {
+		if (rom.codeMap[START_ADDRESS + i] && chip8.ReadMemory(static_cast<uint16_t>(START_ADDRESS + i)) != rom.image[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static std::string Hex(unsigned int value, int digits) {
+	char text[16];
+	snprintf(text, sizeof(text), "0x%0*X", digits, value);
+	return text;
+}
+
+// goto for a known block, otherwise leave through the dispatcher
+static std::string JumpTo(const RomAnalysis& analysis, unsigned int target) {
+	if (analysis.BlockAt(static_cast<uint16_t>(target))) {
+		return "goto b_" + Hex(target, 3).substr(2) + ";";
+	}
+	return "{ ctx.pc = " + Hex(target, 3) + "; goto dispatch; }";
+}
+
+static void EmitBlock(const RomAnalysis& analysis, const BasicBlock& block, std::ostream& out) {
+	unsigned int length = (block.end - block.start) / 2;
+
+	out << "b_" << Hex(block.start, 3).substr(2) << ":\n"
+		<< "\tif (executed + " << length << " > budget) { ctx.pc = " << Hex(block.start, 3) << "; goto done; }\n"
+		<< "\tstart = executed;\n"
+		<< "\texecuted += " << length << ";\n";
+
+	for (unsigned int k = 0; k < length; ++k) {
+		unsigned int address = block.start + 2 * k;
+		uint16_t opcode = analysis.Opcode(static_cast<uint16_t>(address));
+		unsigned int x = (opcode & 0x0F00u) >> 8u;
+		unsigned int y = (opcode & 0x00F0u) >> 4u;
+		std::string Vx = "ctx.V[" + std::to_string(x) + "]";
+		std::string Vy = "ctx.V[" + std::to_string(y) + "]";
+		std::string VF = "ctx.V[15]";
+		std::string kk = Hex(opcode & 0x00FFu, 2);
+		std::string nnn = Hex(opcode & 0x0FFFu, 3);
+		std::string next = Hex(address + 2, 3);
+		std::string overwrite = "if (Overwrites(ctx, " + std::to_string(opcode >> 12u == 0xF && (opcode & 0xFF) == 0x33 ? 3 : x + 1)
+			+ ")) { executed = start + " + std::to_string(k + 1) + "; ctx.pc = " + next + "; ctx.modified = true; goto done; }";
+		std::string skipTaken = JumpTo(analysis, address + 4);
+		std::string skipNot = JumpTo(analysis, address + 2);
+
+		out << "\t// " << Hex(address, 3).substr(2) << "  " << Hex(opcode, 4).substr(2) << "  " << Disassemble(opcode) << "\n\t";
+
+		switch (DecodeHandler(opcode)) {
+			case HANDLER_00E0: out << "ctx.Clear();"; break;
+			case HANDLER_00EE: out << "--ctx.sp; ctx.pc = ctx.stack[ctx.sp & 0xFu]; goto dispatch;"; break;
+			case HANDLER_1nnn: out << JumpTo(analysis, opcode & 0x0FFFu); break;
+			case HANDLER_2nnn: out << "ctx.stack[ctx.sp & 0xFu] = " << next << "; ++ctx.sp; " << JumpTo(analysis, opcode & 0x0FFFu); break;
+			case HANDLER_3xkk: out << "if (" << Vx << " == " << kk << ") " << skipTaken << "\n\t" << skipNot; break;
+			case HANDLER_4xkk: out << "if (" << Vx << " != " << kk << ") " << skipTaken << "\n\t" << skipNot; break;
+			case HANDLER_5xy0: out << "if (" << Vx << " == " << Vy << ") " << skipTaken << "\n\t" << skipNot; break;
+			case HANDLER_6xkk: out << Vx << " = " << kk << ";"; break;
+			case HANDLER_7xkk: out << Vx << " += " << kk << ";"; break;
+			case HANDLER_8xy0: out << Vx << " = " << Vy << ";"; break;
+			case HANDLER_8xy1: out << Vx << " |= " << Vy << ";"; break;
+			case HANDLER_8xy2: out << Vx << " &= " << Vy << ";"; break;
+			case HANDLER_8xy3: out << Vx << " ^= " << Vy << ";"; break;
+			case HANDLER_8xy4: out << "{ uint16_t sum = " << Vx << " + " << Vy << "; " << VF << " = (sum & 0x100u) >> 8u; " << Vx << " = sum & 0xFFu; }"; break;
+			case HANDLER_8xy5: out << VF << " = (" << Vx << " > " << Vy << "); " << Vx << " -= " << Vy << ";"; break;
+			case HANDLER_8xy6: out << "{ uint8_t value = " << Vx << "; " << VF << " = value & 0x1u; " << Vx << " = value >> 1; }"; break;
+			case HANDLER_8xy7: out << VF << " = (" << Vy << " > " << Vx << "); " << Vx << " = " << Vy << " - " << Vx << ";"; break;
+			case HANDLER_8xyE: out << "{ uint8_t value = " << Vx << "; " << VF << " = value >> 7u; " << Vx << " = static_cast<uint8_t>(value << 1); }"; break;
+			case HANDLER_9xy0: out << "if (" << Vx << " != " << Vy << ") " << skipTaken << "\n\t" << skipNot; break;
+			case HANDLER_Annn: out << "ctx.I = " << nnn << ";"; break;
+			case HANDLER_Bnnn: out << "ctx.pc = ctx.V[0] + " << nnn << "; goto dispatch;"; break;
+			case HANDLER_Cxkk: out << Vx << " = ctx.Random() & " << kk << ";"; break;
+			case HANDLER_Dxyn: out << "ctx.Draw(" << Hex(opcode, 4) << ");"; break;
+			case HANDLER_Ex9E: out << "if (ctx.keypad & (1u << (" << Vx << " & 0xFu))) " << skipTaken << "\n\t" << skipNot; break;
+			case HANDLER_ExA1: out << "if (!(ctx.keypad & (1u << (" << Vx << " & 0xFu)))) " << skipTaken << "\n\t" << skipNot; break;
+			case HANDLER_Fx07: out << "ctx.SyncTimers(start + " << k << "); " << Vx << " = ctx.DelayTimer();"; break;
+			case HANDLER_Fx0A: out << "executed = start + " << k << "; ctx.pc = " << Hex(address, 3) << "; goto done;"; break;
+			case HANDLER_Fx15: out << "ctx.SyncTimers(start + " << k << "); ctx.DelayTimer() = " << Vx << ";"; break;
+			case HANDLER_Fx18: out << "ctx.SyncTimers(start + " << k << "); ctx.SoundTimer() = " << Vx << ";"; break;
+			case HANDLER_Fx1E: out << "ctx.I += " << Vx << ";"; break;
+			case HANDLER_Fx29: out << "ctx.I = " << FONTSET_START_ADDRESS << " + (5 * " << Vx << ");"; break;
+			case HANDLER_Fx33:
+				out << "{ uint8_t value = " << Vx << "; ctx.Store(ctx.I + 2, value % 10); value /= 10; ctx.Store(ctx.I + 1, value % 10); value /= 10; ctx.Store(ctx.I, value % 10); }\n\t"
+					<< overwrite;
+				break;
+			case HANDLER_Fx55: out << "for (unsigned int i = 0; i <= " << x << "; ++i) ctx.Store(ctx.I + i, ctx.V[i]);\n\t" << overwrite; break;
+			case HANDLER_Fx65: out << "for (unsigned int i = 0; i <= " << x << "; ++i) ctx.V[i] = ctx.memory[(ctx.I + i) & 0x0FFFu];"; break;
+			case HANDLER_00Cn: case HANDLER_00FB: case HANDLER_00FC: case HANDLER_00FE: case HANDLER_00FF:
+			case HANDLER_Fx30: case HANDLER_Fx75: case HANDLER_Fx85:
+				out << "ctx.Interpret(" << Hex(opcode, 4) << ");";
+				break;
+			case HANDLER_00FD: out << "executed = start + " << k << "; ctx.pc = " << Hex(address, 3) << "; goto done;"; break;
+			default: out << "// no operation"; break;
+		}
+		out << "\n";
+	}
+
+	// blocks that end without a branch fall through or run into data
+	uint16_t last = analysis.Opcode(static_cast<uint16_t>(block.end - 2));
+	OpcodeHandler handler = DecodeHandler(last);
+	bool branches = handler == HANDLER_00EE || handler == HANDLER_1nnn || handler == HANDLER_2nnn || handler == HANDLER_Bnnn
+		|| handler == HANDLER_3xkk || handler == HANDLER_4xkk || handler == HANDLER_5xy0 || handler == HANDLER_9xy0
+		|| handler == HANDLER_Ex9E || handler == HANDLER_ExA1 || handler == HANDLER_Fx0A || handler == HANDLER_00FD;
+
+	if (!branches) {
+		out << "\t" << JumpTo(analysis, block.end) << "\n";
+	}
+	out << "\n";
+}
+
+int RecompileRom(const char* romFilename, const char* outFilename, const char* name) {
+	std::ifstream file(romFilename, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Cannot load " << romFilename << ": " << LoadResultMessage(LoadResult::FileNotFound) << "\n";
+		return 1;
+	}
+
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (rom.empty() || rom.size() > MAX_ROM_SIZE) {
+		std::cerr << "Cannot load " << romFilename << ": " << LoadResultMessage(LoadResult::TooLarge) << "\n";
+		return 1;
+	}
+
+	auto analysis = std::make_unique<RomAnalysis>();
+	AnalyzeRom(rom, *analysis);
+
+	std::ofstream out(outFilename);
+	if (!out.is_open()) {
+		std::cerr << "cannot write " << outFilename << "\n";
+		return 1;
+	}
+
+	out << "// generated by CHIP8_Emulator --recompile from " << romFilename << ", do not edit\n"
+		<< "#include \"recompiler.h\"\n\n"
+		<< "namespace {\n\n";
+
+	out << "const uint8_t image[] = {";
+	for (size_t i = 0; i < rom.size(); ++i) {
+		out << (i % 16 ? " " : "\n\t") << Hex(rom[i], 2) << ",";
+	}
+	out << "\n};\n\n";
+
+	// code bytes, as [start, end) ranges
+	out << "const uint16_t codeRanges[][2] = {";
+	for (unsigned int address = START_ADDRESS; address < analysis->romEnd; ) {
+		if (!(analysis->flags[address] & BYTE_CODE)) {
+			++address;
+			continue;
+		}
+		unsigned int start = address;
+		while (address < analysis->romEnd && (analysis->flags[address] & BYTE_CODE)) {
+			++address;
+		}
+		out << "\n\t{ " << Hex(start, 3) << ", " << Hex(address, 3) << " },";
+	}
+	out << "\n};\n\n";
+
+	out << "struct CodeMap {\n"
+		<< "\tuint8_t bytes[4096]{};\n"
+		<< "\tCodeMap() {\n"
+		<< "\t\tfor (const auto& range : codeRanges) {\n"
+		<< "\t\t\tfor (unsigned int address = range[0]; address < range[1]; ++address) bytes[address] = 1;\n"
+		<< "\t\t}\n"
+		<< "\t}\n"
+		<< "};\n\n"
+		<< "const CodeMap codeMap;\n\n";
+
+	out << "// a store changed compiled code\n"
+		<< "bool Overwrites(const NativeContext& ctx, unsigned int length) {\n"
+		<< "\tfor (unsigned int i = 0; i < length; ++i) {\n"
+		<< "\t\tunsigned int address = (ctx.I + i) & 0x0FFFu;\n"
+		<< "\t\tif (codeMap.bytes[address] && ctx.memory[address] != image[address - " << Hex(START_ADDRESS, 3) << "]) return true;\n"
+		<< "\t}\n"
+		<< "\treturn false;\n"
+		<< "}\n\n";
+
+	out << "uint64_t Run(NativeContext& ctx, uint64_t budget) {\n"
+		<< "\tuint64_t executed = 0;\n"
+		<< "\tuint64_t start = 0;\n"
+		<< "\tctx.timerBase = 0;\n"
+		<< "\tgoto dispatch;\n\n";
+
+	for (const BasicBlock& block : analysis->blocks) {
+		EmitBlock(*analysis, block, out);
+	}
+
+	out << "dispatch:\n"
+		<< "\tswitch (ctx.pc) {\n";
+	for (const BasicBlock& block : analysis->blocks) {
+		out << "\t\tcase " << Hex(block.start, 3) << ": goto b_" << Hex(block.start, 3).substr(2) << ";\n";
+	}
+	out << "\t\tdefault: break;\n"
+		<< "\t}\n\n"
+		<< "done:\n"
+		<< "\tctx.SyncTimers(executed);\n"
+		<< "\treturn executed;\n"
+		<< "}\n\n";
+
+	std::string escapedName;
+	for (const char* c = name; *c; ++c) {
+		if (*c == '\\' || *c == '"') {
+			escapedName += '\\';
+		}
+		escapedName += *c;
+	}
+
+	out << "const bool registered = RegisterNativeRom(NativeRom{ " << Hex(static_cast<unsigned int>(HashRom(rom) >> 32), 8)
+		<< "ull << 32 | " << Hex(static_cast<unsigned int>(HashRom(rom) & 0xFFFFFFFFu), 8) << "ull, \"" << escapedName << "\", image, "
+		<< rom.size() << ", codeMap.bytes, &Run });\n\n"
+		<< "}\n";
+
+	std::cout << analysis->blocks.size() << " blocks written to " << outFilename << "\n";
+	return 0;
+}
+
+
+int CompareNative(const char* romFilename, unsigned int frames, unsigned int cyclesPerFrame) {
+	using Clock = std::chrono::steady_clock;
+
+	std::ifstream file(romFilename, std::ios::binary);
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	const NativeRom* native = FindNativeRom(HashRom(rom));
+	if (!native) {
+		std::cerr << "no compiled code for " << romFilename << ", add the output of --recompile to the build\n";
+		return 1;
+	}
+
+	auto interpreted = std::make_unique<Chip8>();
+	auto compiled = std::make_unique<Chip8>();
+	for (Chip8* chip8 : { interpreted.get(), compiled.get() }) {
+		chip8->LoadROM(rom);
+		chip8->Seed(1);
+	}
+
+	Chip8State boot;
+	interpreted->SaveState(boot);
+
+	// lockstep, frame and state hashes must match
+	NativeRunner runner(*compiled, *native);
+	for (unsigned int frame = 0; frame < frames; ++frame) {
+		for (unsigned int cycle = 0; cycle < cyclesPerFrame; ++cycle) {
+			interpreted->Cycle();
+		}
+		runner.Run(cyclesPerFrame);
+
+		if (interpreted->FrameHash() != compiled->FrameHash()) {
+			std::cerr << "frame " << frame << ": frame hash mismatch\n";
+			return 1;
+		}
+		if (interpreted->StateHash() != compiled->StateHash()) {
+			std::cerr << "frame " << frame << ": state hash mismatch\n";
+			return 1;
+		}
+	}
+	std::cout << frames << " frames match" << (runner.Disabled() ? " (code was modified, ran on the interpreter)" : "") << "\n";
+
+	// timing, from the same boot state
+	uint64_t cycles = static_cast<uint64_t>(frames) * cyclesPerFrame;
+
+	interpreted->LoadState(boot);
+	interpreted->Seed(1);
+	auto start = Clock::now();
+	for (uint64_t cycle = 0; cycle < cycles; ++cycle) {
+		interpreted->Cycle();
+	}
+	double interpreterSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	compiled->LoadState(boot);
+	compiled->Seed(1);
+	NativeRunner timed(*compiled, *native);
+	start = Clock::now();
+	for (unsigned int frame = 0; frame < frames; ++frame) {
+		timed.Run(cyclesPerFrame);
+	}
+	double nativeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::cout << "interpreter " << interpreterSeconds * 1e9 / cycles << " ns/cycle, compiled "
+		<< nativeSeconds * 1e9 / cycles << " ns/cycle, speed-up " << interpreterSeconds / nativeSeconds << "x\n";
+	return 0;
+}
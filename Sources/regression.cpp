@@ -0,0 +1,355 @@
+#include "regression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "chip8.h"
+
+
+bool LoadMovie(const char* filename, std::vector<MovieInput>& movie) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	movie.clear();
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		MovieInput input{};
+		unsigned int keypad;
+		if (line.empty() || line[0] == '#' || !(fields >> input.frame >> std::hex >> keypad)) {
+			continue;
+		}
+		input.keypad = static_cast<uint16_t>(keypad);
+		movie.push_back(input);
+	}
+
+	std::stable_sort(movie.begin(), movie.end(), [](const MovieInput& a, const MovieInput& b) { return a.frame < b.frame; });
+	return true;
+}
+
+bool LoadManifest(const char* filename, std::vector<RegressionEntry>& entries, std::ostream& errors) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		errors << "cannot open " << filename << "\n";
+		return false;
+	}
+
+	std::filesystem::path directory = std::filesystem::path(filename).parent_path();
+	bool ok = true;
+	std::string line;
+
+	for (unsigned int number = 1; std::getline(file, line); ++number) {
+		std::istringstream fields(line);
+		RegressionEntry entry;
+		std::string movie, quirks;
+
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		if (!(fields >> entry.rom >> entry.seed >> movie >> quirks >> entry.cyclesPerFrame)
+			|| !ParseQuirkProfile(quirks.c_str(), entry.quirks)) {
+			errors << filename << ":" << number << ": expected <rom> <seed> <movie> <quirks> <cyclesPerFrame> <frame>=<hash>...\n";
+			ok = false;
+			continue;
+		}
+
+		entry.rom = (directory / entry.rom).string();
+		if (movie != "-") {
+			entry.movie = (directory / movie).string();
+		}
+
+		std::string golden;
+		while (fields >> golden) {
+			size_t split = golden.find('=');
+			if (split == std::string::npos) {
+				errors << filename << ":" << number << ": bad frame " << golden << "\n";
+				ok = false;
+				break;
+			}
+			entry.frames.push_back({ static_cast<uint32_t>(std::stoul(golden.substr(0, split))), std::stoull(golden.substr(split + 1), nullptr, 16) });
+		}
+		std::sort(entry.frames.begin(), entry.frames.end(), [](const GoldenFrame& a, const GoldenFrame& b) { return a.frame < b.frame; });
+
+		entries.push_back(std::move(entry));
+	}
+
+	return ok;
+}
+
+namespace {
+	const uint32_t PNG_SCALE = 4;
+
+	uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+		static uint32_t table[256] = {};
+		static std::once_flag once;
+		std::call_once(once, []() {
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = c & 1u ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+				}
+				table[n] = c;
+			}
+		});
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8u);
+		}
+		return ~crc;
+	}
+
+	void PutBig32(std::vector<uint8_t>& out, uint32_t value) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			out.push_back(static_cast<uint8_t>(value >> shift));
+		}
+	}
+
+	void WriteChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data) {
+		std::vector<uint8_t> chunk;
+		PutBig32(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		PutBig32(chunk, Crc32(0, chunk.data() + 4, chunk.size() - 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+	}
+
+	// 8-bit greyscale PNG with stored (uncompressed) deflate blocks, no zlib needed
+	bool WritePng(const std::string& filename, uint32_t width, uint32_t height, const uint8_t* grey) {
+		std::ofstream file(filename, std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+		std::vector<uint8_t> header;
+		PutBig32(header, width);
+		PutBig32(header, height);
+		header.insert(header.end(), { 8, 0, 0, 0, 0 });	// 8 bits, greyscale, deflate, no filter, no interlace
+		WriteChunk(file, "IHDR", header);
+
+		// each row starts with filter type 0
+		std::vector<uint8_t> raw;
+		for (uint32_t y = 0; y < height; ++y) {
+			raw.push_back(0);
+			raw.insert(raw.end(), grey + y * width, grey + (y + 1) * width);
+		}
+
+		std::vector<uint8_t> zlib = { 0x78, 0x01 };
+		uint32_t a = 1, b = 0;
+		for (size_t offset = 0; offset < raw.size() || offset == 0;) {
+			uint16_t length = static_cast<uint16_t>(std::min<size_t>(raw.size() - offset, 0xFFFF));
+			bool last = offset + length == raw.size();
+			zlib.insert(zlib.end(), { static_cast<uint8_t>(last), static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8u),
+				static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8u) });
+			zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+			for (size_t i = offset; i < offset + length; ++i) {
+				a = (a + raw[i]) % 65521;
+				b = (b + a) % 65521;
+			}
+			offset += length;
+			if (last) {
+				break;
+			}
+		}
+		PutBig32(zlib, (b << 16u) | a);
+		WriteChunk(file, "IDAT", zlib);
+		WriteChunk(file, "IEND", {});
+
+		return file.good();
+	}
+
+	// the display at its current resolution, PNG_SCALE times, plane combinations as grey levels
+	template <typename Machine>
+	bool DumpFrame(const Machine& chip8, const std::string& filename) {
+		static const uint8_t levels[4] = { 0, 255, 170, 85 };
+		uint32_t width = chip8.VideoWidth() * PNG_SCALE;
+		uint32_t height = chip8.VideoHeight() * PNG_SCALE;
+
+		std::vector<uint8_t> grey(width * height);
+		for (uint32_t y = 0; y < height; ++y) {
+			for (uint32_t x = 0; x < width; ++x) {
+				grey[y * width + x] = levels[chip8.PixelPlanes(x / PNG_SCALE, y / PNG_SCALE)];
+			}
+		}
+		return WritePng(filename, width, height, grey.data());
+	}
+
+	struct FrameResult {
+		uint32_t frame;
+		uint64_t expected;
+		uint64_t actual;
+	};
+
+	// the entry's position in the manifest keeps two entries of the same ROM apart
+	std::string DumpName(const RegressionEntry& entry, size_t index, uint32_t frame) {
+		return std::filesystem::path(entry.rom).stem().string() + "_" + std::to_string(index) + "_" + std::to_string(frame) + ".png";
+	}
+
+	// run one entry up to its last golden frame, the hash of every golden frame in order
+	template <typename Machine>
+	bool RunEntry(const RegressionEntry& entry, size_t index, std::vector<FrameResult>& results, const char* dumpDirectory, std::string& error) {
+		std::vector<MovieInput> movie;
+		if (!entry.movie.empty() && !LoadMovie(entry.movie.c_str(), movie)) {
+			error = "cannot open movie " + entry.movie;
+			return false;
+		}
+
+		auto chip8 = std::make_unique<Machine>();
+		LoadResult loaded = chip8->LoadROM(entry.rom.c_str());
+		if (loaded != LoadResult::Ok) {
+			error = entry.rom + ": " + LoadResultMessage(loaded);
+			return false;
+		}
+		chip8->Seed(entry.seed);
+
+		size_t input = 0;
+		uint32_t frame = 0;
+		for (const GoldenFrame& golden : entry.frames) {
+			for (; frame < golden.frame; ++frame) {
+				while (input < movie.size() && movie[input].frame <= frame) {
+					chip8->keypad = movie[input++].keypad;
+				}
+				for (unsigned int cycle = 0; cycle < entry.cyclesPerFrame; ++cycle) {
+					chip8->Cycle();
+				}
+			}
+
+			uint64_t hash = chip8->FrameHash();
+			results.push_back({ golden.frame, golden.hash, hash });
+
+			if (hash != golden.hash && dumpDirectory) {
+				DumpFrame(*chip8, (std::filesystem::path(dumpDirectory) / DumpName(entry, index, golden.frame)).string());
+			}
+		}
+		return true;
+	}
+
+	struct EntryResult {
+		bool ran{};
+		std::string error;
+		std::vector<FrameResult> frames;
+	};
+
+	void RunEntries(const std::vector<RegressionEntry>& entries, std::vector<EntryResult>& results, unsigned int threads, const char* dumpDirectory) {
+		results.assign(entries.size(), EntryResult());
+		std::atomic<size_t> next{ 0 };
+
+		auto worker = [&]() {
+			for (size_t i = next++; i < entries.size(); i = next++) {
+				EntryResult& result = results[i];
+				result.ran = VisitQuirkProfile(entries[i].quirks, [&]<typename Machine>() {
+					return RunEntry<Machine>(entries[i], i, result.frames, dumpDirectory, result.error);
+				});
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (unsigned int t = 0; t < threads; ++t) {
+			pool.emplace_back(worker);
+		}
+		for (std::thread& thread : pool) {
+			thread.join();
+		}
+	}
+}
+
+int RunRegression(const char* manifestFilename, unsigned int threads, const char* dumpDirectory) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	std::vector<RegressionEntry> entries;
+	if (!LoadManifest(manifestFilename, entries, std::cerr)) {
+		return 1;
+	}
+
+	std::error_code ignored;
+	std::filesystem::create_directories(dumpDirectory, ignored);
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<EntryResult> results;
+	RunEntries(entries, results, threads, dumpDirectory);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t checked = 0, failed = 0, broken = 0;
+	uint64_t frames = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (!results[i].ran) {
+			std::cout << "ERROR " << entries[i].rom << ": " << results[i].error << "\n";
+			++broken;
+			continue;
+		}
+		for (const FrameResult& frame : results[i].frames) {
+			++checked;
+			if (frame.actual != frame.expected) {
+				std::cout << "FAIL " << entries[i].rom << " frame " << frame.frame << ": expected " << std::hex << std::setw(16) << std::setfill('0')
+					<< frame.expected << ", got " << std::setw(16) << frame.actual << std::dec << std::setfill(' ')
+					<< ", " << (std::filesystem::path(dumpDirectory) / DumpName(entries[i], i, frame.frame)).string() << "\n";
+				++failed;
+			}
+		}
+		frames += entries[i].frames.empty() ? 0 : entries[i].frames.back().frame;
+	}
+
+	std::cout << entries.size() << " ROM(s), " << checked << " golden frame(s), " << failed << " mismatch(es), " << broken << " error(s) in "
+		<< seconds << " s on " << threads << " thread(s), " << frames / seconds << " frames/s\n";
+	if (failed) {
+		std::cout << "mismatching frames dumped to " << dumpDirectory << "\n";
+	}
+
+	return failed || broken ? 1 : 0;
+}
+
+int RecordRegression(const char* manifestFilename, std::ostream& out) {
+	std::vector<RegressionEntry> entries;
+	if (!LoadManifest(manifestFilename, entries, std::cerr)) {
+		return 1;
+	}
+
+	std::vector<EntryResult> results;
+	RunEntries(entries, results, std::max(1u, std::thread::hardware_concurrency()), nullptr);
+
+	// the lines again with the hashes replaced, everything else as written
+	std::ifstream file(manifestFilename);
+	std::string line;
+	size_t i = 0;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') {
+			out << line << "\n";
+			continue;
+		}
+
+		std::istringstream fields(line);
+		std::string rom, seed, movie, quirks, cyclesPerFrame;
+		fields >> rom >> seed >> movie >> quirks >> cyclesPerFrame;
+		out << rom << " " << seed << " " << movie << " " << quirks << " " << cyclesPerFrame;
+
+		if (i < results.size() && !results[i].ran) {
+			std::cerr << entries[i].rom << ": " << results[i].error << "\n";
+		}
+		if (i < results.size()) {
+			for (const FrameResult& frame : results[i].frames) {
+				out << " " << frame.frame << "=" << std::hex << std::setw(16) << std::setfill('0') << frame.actual << std::dec << std::setfill(' ');
+			}
+		}
+		out << "\n";
+		++i;
+	}
+
+	return 0;
+}
@@ -0,0 +1,257 @@
+#include "rom_store.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+uint64_t HashRom(std::span<const uint8_t> rom) {
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (uint8_t byte : rom) {
+		hash ^= byte;
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+struct RomMetadata {
+	unsigned int cyclesPerFrame;
+	QuirkProfile quirks;
+	unsigned int bootFrames;
+};
+
+int BuildRomStore(const char* romDirectory, const char* indexFilename, unsigned int cyclesPerFrame, unsigned int bootFrames) {
+	namespace fs = std::filesystem;
+
+	std::error_code error;
+	if (!fs::is_directory(romDirectory, error)) {
+		std::cerr << "not a directory: " << romDirectory << "\n";
+		return 1;
+	}
+
+	std::map<std::string, RomMetadata> metadata;
+	{
+		std::ifstream file(fs::path(romDirectory) / "metadata.txt");
+		std::string line;
+
+		while (std::getline(file, line)) {
+			std::istringstream fields(line);
+			std::string name, quirks;
+			RomMetadata entry{ cyclesPerFrame, QuirkProfile::Default, bootFrames };
+
+			if (fields >> name >> entry.cyclesPerFrame >> quirks >> entry.bootFrames) {
+				if (!ParseQuirkProfile(quirks.c_str(), entry.quirks)) {
+					std::cerr << "metadata.txt: unknown quirks " << quirks << " for " << name << "\n";
+					continue;
+				}
+				metadata[name] = entry;
+			}
+		}
+	}
+
+	std::vector<std::unique_ptr<RomStoreEntry>> entries;
+
+	for (const fs::directory_entry& item : fs::directory_iterator(romDirectory, error)) {
+		std::string name = item.path().filename().string();
+		if (!item.is_regular_file() || name == "metadata.txt") {
+			continue;
+		}
+
+		auto entry = std::make_unique<RomStoreEntry>();
+		memset(entry.get(), 0, sizeof(RomStoreEntry));
+
+		std::ifstream file(item.path(), std::ios::binary | std::ios::ate);
+		std::streamoff size = file.tellg();
+		if (size <= 0 || size > static_cast<std::streamoff>(MAX_ROM_SIZE)) {
+			std::cerr << "skipping " << name << ": " << LoadResultMessage(LoadResult::TooLarge) << "\n";
+			continue;
+		}
+		file.seekg(0, std::ios::beg);
+		file.read(reinterpret_cast<char*>(entry->rom), size);
+
+		RomMetadata settings{ cyclesPerFrame, QuirkProfile::Default, bootFrames };
+		auto found = metadata.find(name);
+		if (found != metadata.end()) {
+			settings = found->second;
+		}
+
+		if (settings.quirks == QuirkProfile::XoChip) {
+			std::cerr << "skipping " << name << ": XO-CHIP snapshots do not fit the store\n";
+			continue;
+		}
+
+		std::span<const uint8_t> image(entry->rom, static_cast<size_t>(size));
+		entry->hash = HashRom(image);
+		strncpy(entry->name, name.c_str(), sizeof(entry->name) - 1);
+		entry->size = static_cast<uint16_t>(size);
+		entry->cyclesPerFrame = static_cast<uint16_t>(settings.cyclesPerFrame);
+		entry->quirks = static_cast<uint32_t>(settings.quirks);
+		entry->bootFrames = settings.bootFrames;
+
+		// boot once here so workers never have to, on the machine of the ROM's quirks
+		VisitQuirkProfile(settings.quirks, [&]<typename Machine>() {
+			if constexpr (std::is_same_v<typename Machine::State, Chip8State>) {
+				Machine chip8;
+				chip8.Seed(0);
+				chip8.LoadROM(image);
+				for (unsigned int cycle = 0; cycle < settings.bootFrames * settings.cyclesPerFrame; ++cycle) {
+					chip8.Cycle();
+				}
+				chip8.SaveState(entry->boot);
+			}
+		});
+
+		entries.push_back(std::move(entry));
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const std::unique_ptr<RomStoreEntry>& a, const std::unique_ptr<RomStoreEntry>& b) {
+		return a->hash < b->hash;
+	});
+
+	MappedFile index;
+	if (!index.OpenWrite(indexFilename, sizeof(RomStoreHeader) + entries.size() * sizeof(RomStoreEntry))) {
+		std::cerr << "cannot write " << indexFilename << "\n";
+		return 1;
+	}
+
+	RomStoreHeader header{};
+	memcpy(header.magic, "C8RS", 4);
+	header.entrySize = sizeof(RomStoreEntry);
+	header.count = static_cast<uint32_t>(entries.size());
+	memcpy(index.Data(), &header, sizeof(header));
+
+	for (size_t i = 0; i < entries.size(); ++i) {
+		memcpy(index.Data() + sizeof(header) + i * sizeof(RomStoreEntry), entries[i].get(), sizeof(RomStoreEntry));
+	}
+
+	std::cout << entries.size() << " ROM(s) indexed into " << indexFilename << "\n";
+	return 0;
+}
+
+
+bool RomStore::Open(const char* indexFilename) {
+	entries = nullptr;
+	count = 0;
+
+	if (!file.OpenRead(indexFilename) || file.Size() < sizeof(RomStoreHeader)) {
+		return false;
+	}
+
+	RomStoreHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+
+	if (memcmp(header.magic, "C8RS", 4) != 0 || header.entrySize != sizeof(RomStoreEntry)
+		|| file.Size() < sizeof(header) + static_cast<size_t>(header.count) * sizeof(RomStoreEntry)) {
+		file.Close();
+		return false;
+	}
+
+	entries = reinterpret_cast<const RomStoreEntry*>(file.Data() + sizeof(header));
+	count = header.count;
+	return true;
+}
+
+const RomStoreEntry* RomStore::Find(uint64_t hash) const {
+	const RomStoreEntry* end = entries + count;
+	const RomStoreEntry* found = std::lower_bound(entries, end, hash, [](const RomStoreEntry& entry, uint64_t value) {
+		return entry.hash < value;
+	});
+
+	return found != end && found->hash == hash ? found : nullptr;
+}
+
+const RomStoreEntry* RomStore::FindByName(const char* name) const {
+	for (size_t i = 0; i < count; ++i) {
+		if (strncmp(entries[i].name, name, sizeof(entries[i].name)) == 0) {
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+
+QuirkProfile SelectQuirkProfile(const char* romFilename, const RomStore* store) {
+	std::ifstream file(romFilename, std::ios::binary);
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (store) {
+		const RomStoreEntry* entry = store->Find(HashRom(rom));
+		if (entry && entry->quirks < static_cast<uint32_t>(QuirkProfile::Count)) {
+			return static_cast<QuirkProfile>(entry->quirks);
+		}
+	}
+
+	std::string extension = std::filesystem::path(romFilename).extension().string();
+	if (extension == ".xo8" || rom.size() > MAX_ROM_SIZE) {
+		return QuirkProfile::XoChip;
+	}
+	if (extension == ".sc8") {
+		return QuirkProfile::Schip;
+	}
+	return QuirkProfile::Default;
+}
+
+
+int MeasureRomStartup(const char* indexFilename, const char* romDirectory, unsigned int instances) {
+	using Clock = std::chrono::steady_clock;
+
+	// the store is mapped once per process, include that in the first instance
+	auto mapStart = Clock::now();
+	RomStore store;
+	if (!store.Open(indexFilename)) {
+		std::cerr << "cannot open ROM store " << indexFilename << "\n";
+		return 1;
+	}
+	double mapMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - mapStart).count();
+
+	for (size_t i = 0; i < store.Count(); ++i) {
+		const RomStoreEntry& entry = store.Entry(i);
+		std::string path = std::string(romDirectory) + "/" + entry.name;
+		QuirkProfile quirks = entry.quirks < static_cast<uint32_t>(QuirkProfile::Count) ? static_cast<QuirkProfile>(entry.quirks) : QuirkProfile::Default;
+
+		// time the machine the entry was booted on, as BuildRomStore did
+		VisitQuirkProfile(quirks, [&]<typename Machine>() {
+			if constexpr (std::is_same_v<typename Machine::State, Chip8State>) {
+				// allocated once, outside the timing; a file start resets it to
+				// power-on with a snapshot rather than constructing a new machine
+				auto chip8 = std::make_unique<Machine>();
+				chip8->Seed(0);
+				auto powerOn = std::make_unique<typename Machine::State>();
+				chip8->SaveState(*powerOn);
+
+				// from files: reset, open, read, boot
+				auto start = Clock::now();
+				for (unsigned int n = 0; n < instances; ++n) {
+					chip8->LoadState(*powerOn);
+					chip8->LoadROM(path.c_str());
+					for (unsigned int cycle = 0; cycle < entry.bootFrames * entry.cyclesPerFrame; ++cycle) {
+						chip8->Cycle();
+					}
+				}
+				double fileMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / instances;
+
+				// from the store: look up by hash, restore the snapshot
+				start = Clock::now();
+				for (unsigned int n = 0; n < instances; ++n) {
+					const RomStoreEntry* found = store.Find(entry.hash);
+					RomStore::Start(*found, *chip8);
+				}
+				double storeMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / instances;
+
+				std::cout << entry.name << " (" << QuirkProfileName(quirks) << "): files " << fileMicroseconds
+					<< " us/instance (reset from a power-on snapshot, load, boot), store " << storeMicroseconds
+					<< " us/instance (+" << mapMicroseconds << " us to map the store once)\n";
+			}
+		});
+	}
+
+	return 0;
+}
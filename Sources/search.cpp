@@ -0,0 +1,374 @@
+#include "search.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+#include "chip8.h"
+
+
+bool ParseSearchTerms(const char* text, std::vector<ScoreAddress>& score, std::vector<GoalAddress>& goal) {
+	score.clear();
+	goal.clear();
+
+	const char* term = text;
+	while (*term) {
+		char* end;
+		unsigned long address = std::strtoul(term, &end, 0);
+		if (end == term || address > 0xFFFF || (*end != ':' && *end != '=')) {
+			return false;
+		}
+
+		char separator = *end;
+		const char* number = end + 1;
+		if (separator == ':') {
+			double weight = std::strtod(number, &end);
+			if (end == number) {
+				return false;
+			}
+			score.push_back({ static_cast<uint16_t>(address), weight });
+		}
+		else {
+			unsigned long value = std::strtoul(number, &end, 0);
+			if (end == number || value > 0xFF) {
+				return false;
+			}
+			goal.push_back({ static_cast<uint16_t>(address), static_cast<uint8_t>(value) });
+		}
+
+		if (*end == ',') {
+			++end;
+		}
+		else if (*end) {
+			return false;
+		}
+		term = end;
+	}
+
+	return !score.empty() || !goal.empty();
+}
+
+bool ParseSearchKeys(const char* text, std::vector<uint16_t>& actions) {
+	actions.assign(1, 0);
+
+	if (!*text) {
+		for (unsigned int key = 0; key < 16; ++key) {
+			actions.push_back(static_cast<uint16_t>(1u << key));
+		}
+		return true;
+	}
+
+	for (const char* digit = text; *digit; ++digit) {
+		if (!std::isxdigit(static_cast<unsigned char>(*digit))) {
+			return false;
+		}
+		char hex[2] = { *digit, 0 };
+		uint16_t mask = static_cast<uint16_t>(1u << std::strtoul(hex, nullptr, 16));
+		if (std::find(actions.begin(), actions.end(), mask) == actions.end()) {
+			actions.push_back(mask);
+		}
+	}
+	return true;
+}
+
+
+namespace {
+	const uint32_t NO_PARENT = UINT32_MAX;
+
+	// a state the search kept: how it was reached, 16 bytes; its State only
+	// lives while it is on the frontier
+	struct SearchNode {
+		uint32_t parent;		// index into the node list
+		uint16_t keypad;		// action from the parent
+		double score;
+	};
+
+	// an action run on a frontier state at the current depth
+	struct Child {
+		uint64_t hash;
+		double score;
+		uint32_t frontier;		// index of the parent's State on the frontier
+		uint16_t keypad;
+		bool goal;
+	};
+
+	// set of StateHash values seen, open addressing, at most half full
+	class TranspositionTable {
+	public:
+		// false if hash was already in
+		bool Insert(uint64_t hash) {
+			if (hash == 0) {
+				bool seen = haveZero;
+				haveZero = true;
+				return !seen;
+			}
+			if (2 * (count + 1) > slots.size()) {
+				Grow();
+			}
+
+			size_t mask = slots.size() - 1;
+			for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+				if (slots[slot] == hash) {
+					return false;
+				}
+				if (slots[slot] == 0) {
+					slots[slot] = hash;
+					++count;
+					return true;
+				}
+			}
+		}
+
+		uint64_t Bytes() const { return slots.capacity() * sizeof(uint64_t); }
+
+	private:
+		void Grow() {
+			std::vector<uint64_t> old(std::max<size_t>(1024, 2 * slots.size()), 0);
+			old.swap(slots);
+
+			size_t mask = slots.size() - 1;
+			for (uint64_t hash : old) {
+				if (hash) {
+					size_t slot = hash & mask;
+					while (slots[slot]) {
+						slot = (slot + 1) & mask;
+					}
+					slots[slot] = hash;
+				}
+			}
+		}
+
+		std::vector<uint64_t> slots;	// 0 is an empty slot
+		size_t count{};
+		bool haveZero{};
+	};
+
+	// fn(thread, i) for i in [0, count) on threads, each thread with its own i's
+	template <typename Function>
+	void ParallelFor(size_t count, unsigned int threads, Function fn) {
+		std::atomic<size_t> next{ 0 };
+		auto worker = [&](unsigned int thread) {
+			for (size_t i = next++; i < count; i = next++) {
+				fn(thread, i);
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (unsigned int t = 1; t < threads; ++t) {
+			pool.emplace_back(worker, t);
+		}
+		worker(0);
+		for (std::thread& thread : pool) {
+			thread.join();
+		}
+	}
+
+	template <typename Machine>
+	double Score(const Machine& chip8, const SearchConfig& config) {
+		double score = 0.0;
+		for (const ScoreAddress& term : config.score) {
+			score += term.weight * chip8.ReadMemory(term.address);
+		}
+		return score;
+	}
+
+	template <typename Machine>
+	bool MeetsGoal(const Machine& chip8, const SearchConfig& config) {
+		if (config.goal.empty()) {
+			return false;
+		}
+		for (const GoalAddress& term : config.goal) {
+			if (chip8.ReadMemory(term.address) != term.value) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <typename Machine>
+	void Step(Machine& chip8, const SearchConfig& config, uint16_t keypad) {
+		chip8.keypad = keypad;
+		for (unsigned int frame = 0; frame < config.framesPerStep; ++frame) {
+			for (unsigned int cycle = 0; cycle < config.cyclesPerFrame; ++cycle) {
+				chip8.Cycle();
+			}
+		}
+	}
+
+	template <typename Machine>
+	bool Search(const char* romFilename, const SearchConfig& config, SearchResult& result, std::string& error) {
+		typedef typename Machine::State State;
+
+		unsigned int threads = config.threads ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+		std::vector<uint16_t> actions = config.actions;
+		if (actions.empty()) {
+			ParseSearchKeys("", actions);
+		}
+
+		// one machine per thread, everything they run comes from a State
+		std::vector<std::unique_ptr<Machine>> machines;
+		for (unsigned int t = 0; t < threads; ++t) {
+			machines.push_back(std::make_unique<Machine>());
+		}
+
+		Machine& root = *machines[0];
+		LoadResult loaded = root.LoadROM(romFilename);
+		if (loaded != LoadResult::Ok) {
+			error = std::string(romFilename) + ": " + LoadResultMessage(loaded);
+			return false;
+		}
+		root.Seed(config.seed);
+		for (unsigned int frame = 0; frame < config.bootFrames; ++frame) {
+			for (unsigned int cycle = 0; cycle < config.cyclesPerFrame; ++cycle) {
+				root.Cycle();
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<SearchNode> nodes{ { NO_PARENT, 0, Score(root, config) } };
+		TranspositionTable table;
+		table.Insert(root.StateHash());
+
+		std::vector<State> frontier(1), next;
+		std::vector<uint32_t> frontierNodes{ 0 }, nextNodes;
+		root.SaveState(frontier[0]);
+
+		std::vector<Child> children;
+		std::vector<uint32_t> kept;
+		uint32_t best = 0;
+		bool reachedGoal = MeetsGoal(root, config);
+		result = SearchResult();
+
+		for (unsigned int depth = 1; depth <= config.maxDepth && !reachedGoal && !frontier.empty(); ++depth) {
+			// every action on every frontier state, kept as a Child
+			children.resize(frontier.size() * actions.size());
+			ParallelFor(frontier.size(), threads, [&](unsigned int thread, size_t parent) {
+				Machine& chip8 = *machines[thread];
+				for (size_t action = 0; action < actions.size(); ++action) {
+					chip8.LoadState(frontier[parent]);
+					Step(chip8, config, actions[action]);
+					children[parent * actions.size() + action] = { chip8.StateHash(), Score(chip8, config), static_cast<uint32_t>(parent), actions[action], MeetsGoal(chip8, config) };
+				}
+			});
+			result.expanded += children.size();
+			result.depth = depth;
+
+			// new states only, in the order they were run so any thread count finds the same path
+			kept.clear();
+			for (uint32_t i = 0; i < children.size(); ++i) {
+				if (table.Insert(children[i].hash)) {
+					kept.push_back(i);
+				}
+			}
+			result.transpositions += children.size() - kept.size();
+
+			auto goal = std::find_if(kept.begin(), kept.end(), [&](uint32_t i) { return children[i].goal; });
+			if (goal != kept.end()) {
+				kept.assign(1, *goal);
+				reachedGoal = true;
+			}
+			else if (config.width && kept.size() > config.width) {
+				std::stable_sort(kept.begin(), kept.end(), [&](uint32_t a, uint32_t b) { return children[a].score > children[b].score; });
+				kept.resize(config.width);
+			}
+			if (nodes.size() + kept.size() > config.maxNodes) {
+				kept.resize(config.maxNodes > nodes.size() ? config.maxNodes - nodes.size() : 0);
+			}
+
+			nextNodes.clear();
+			for (uint32_t i : kept) {
+				const Child& child = children[i];
+				nextNodes.push_back(static_cast<uint32_t>(nodes.size()));
+				nodes.push_back({ frontierNodes[child.frontier], child.keypad, child.score });
+				if (child.goal || (!reachedGoal && child.score >= nodes[best].score)) {
+					best = nextNodes.back();
+				}
+			}
+
+			// run the survivors again for their States; this depth's table lookups and scores are done
+			next.resize(kept.size());
+			ParallelFor(kept.size(), threads, [&](unsigned int thread, size_t i) {
+				Machine& chip8 = *machines[thread];
+				const Child& child = children[kept[i]];
+				chip8.LoadState(frontier[child.frontier]);
+				Step(chip8, config, child.keypad);
+				chip8.SaveState(next[i]);
+			});
+
+			result.bytes = std::max<uint64_t>(result.bytes, nodes.capacity() * sizeof(SearchNode) + table.Bytes()
+				+ children.capacity() * sizeof(Child) + (frontier.capacity() + next.capacity()) * sizeof(State));
+
+			frontier.swap(next);
+			frontierNodes.swap(nextNodes);
+		}
+
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.reachedGoal = reachedGoal;
+		result.score = nodes[best].score;
+		result.kept = nodes.size();
+		result.stateBytes = sizeof(State);
+		for (uint32_t node = best; nodes[node].parent != NO_PARENT; node = nodes[node].parent) {
+			result.inputs.push_back(nodes[node].keypad);
+		}
+		std::reverse(result.inputs.begin(), result.inputs.end());
+		return true;
+	}
+}
+
+bool RunSearch(const char* romFilename, const SearchConfig& config, SearchResult& result, std::string& error) {
+	return VisitQuirkProfile(config.quirks, [&]<typename Machine>() {
+		return Search<Machine>(romFilename, config, result, error);
+	});
+}
+
+bool WriteSearchMovie(const char* filename, const SearchConfig& config, const std::vector<uint16_t>& inputs) {
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << "# " << inputs.size() << " steps of " << config.framesPerStep << " frames after " << config.bootFrames
+		<< " boot frames, seed " << config.seed << ", " << config.cyclesPerFrame << " cycles per frame\n";
+	uint32_t frame = config.bootFrames;
+	for (uint16_t keypad : inputs) {
+		file << frame << " " << std::hex << keypad << std::dec << "\n";
+		frame += config.framesPerStep;
+	}
+	file << frame << " 0\n";	// keys released after the last step
+	return file.good();
+}
+
+int RunSearchDriver(const char* romFilename, const SearchConfig& config, const char* movieFilename, std::ostream& out) {
+	SearchResult result;
+	std::string error;
+	if (!RunSearch(romFilename, config, result, error)) {
+		out << error << "\n";
+		return 1;
+	}
+
+	unsigned int threads = config.threads ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+	out << romFilename << ": depth " << result.depth << ", " << result.expanded << " node(s) run, " << result.transpositions
+		<< " transposition(s), " << result.kept << " state(s) kept in " << result.seconds << " s on " << threads << " thread(s)\n";
+	out << result.expanded / result.seconds << " nodes/s, " << result.bytes << " bytes peak, "
+		<< static_cast<double>(result.bytes) / static_cast<double>(result.kept) << " bytes per kept state ("
+		<< sizeof(SearchNode) << "-byte node records, " << result.stateBytes << "-byte snapshots on the frontier only)\n";
+	out << (result.reachedGoal ? "goal reached" : config.goal.empty() ? "best score" : "goal not reached, best score")
+		<< " " << result.score << " after " << result.inputs.size() << " step(s)\n";
+
+	if (movieFilename && !WriteSearchMovie(movieFilename, config, result.inputs)) {
+		out << "cannot write " << movieFilename << "\n";
+		return 1;
+	}
+	if (movieFilename) {
+		out << "path written to " << movieFilename << " (" << QuirkProfileName(config.quirks) << ", seed " << config.seed << ", "
+			<< config.cyclesPerFrame << " cycles per frame)\n";
+	}
+
+	return !config.goal.empty() && !result.reachedGoal ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+#include "session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+
+std::atomic<size_t> SessionTask::frameBytes{ 0 };
+
+void* SessionTask::promise_type::operator new(size_t size) {
+	frameBytes.fetch_add(size, std::memory_order_relaxed);
+	return ::operator new(size);
+}
+
+void SessionTask::promise_type::operator delete(void* frame, size_t size) {
+	frameBytes.fetch_sub(size, std::memory_order_relaxed);
+	::operator delete(frame);
+}
+
+SessionTask& SessionTask::operator=(SessionTask&& other) noexcept {
+	if (this != &other) {
+		if (handle) {
+			handle.destroy();
+		}
+		handle = other.handle;
+		other.handle = nullptr;
+	}
+	return *this;
+}
+
+SessionTask::~SessionTask() {
+	if (handle) {
+		handle.destroy();
+	}
+}
+
+
+Session::Session(const char* romFilename, unsigned int cyclesPerFrame) : cyclesPerFrame(cyclesPerFrame) {
+	status = chip8.LoadROM(romFilename);
+}
+
+void Session::EmulateFrame() {
+	for (unsigned int cycle = 0; cycle < cyclesPerFrame; ++cycle) {
+		chip8.Cycle();
+
+		// nothing more can happen until a key arrives
+		if (chip8.WaitingForKey()) {
+			break;
+		}
+	}
+	++frame;
+}
+
+void Session::FrameAwaiter::await_suspend(std::coroutine_handle<> handle) {
+	session.waiting = handle;
+	session.scheduler->frameQueue.push_back(&session);
+}
+
+void Session::KeyAwaiter::await_suspend(std::coroutine_handle<> handle) {
+	session.waiting = handle;
+	session.waitingForKey = true;
+}
+
+
+Scheduler::Scheduler(unsigned int threads) : threads(threads ? threads : 1) {
+	for (unsigned int t = 1; t < this->threads; ++t) {
+		workers.emplace_back(&Scheduler::Work, this);
+	}
+}
+
+Scheduler::~Scheduler() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void Scheduler::Spawn(Session& session, SessionTask task) {
+	session.scheduler = this;
+	ready.push_back(task.handle);
+	tasks.push_back(std::move(task));
+}
+
+void Scheduler::PostKey(Session& session, uint8_t key, bool pressed) {
+	uint16_t bit = static_cast<uint16_t>(1u << (key & 0xFu));
+	session.chip8.keypad = pressed ? session.chip8.keypad | bit : session.chip8.keypad & ~bit;
+
+	if (pressed && session.waitingForKey) {
+		session.waitingForKey = false;
+		session.lastKey = key & 0xFu;
+		ready.push_back(session.waiting);
+	}
+}
+
+void Scheduler::RunFrame() {
+	// sessions woken since the last frame (new or key press) run up to their next await
+	std::vector<std::coroutine_handle<>> woken;
+	woken.swap(ready);
+	for (std::coroutine_handle<> handle : woken) {
+		handle.resume();
+	}
+
+	running.clear();
+	running.swap(frameQueue);
+
+	// emulate, split across the pool if there is one
+	if (!workers.empty() && running.size() >= threads) {
+		next.store(0, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++generation;
+			busy = static_cast<unsigned int>(workers.size());
+		}
+		wake.notify_all();
+
+		EmulateRunning();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this]() { return busy == 0; });
+	}
+	else {
+		for (Session* session : running) {
+			session->EmulateFrame();
+		}
+	}
+
+	for (Session* session : running) {
+		session->waiting.resume();
+	}
+}
+
+void Scheduler::EmulateRunning() {
+	const size_t CHUNK = 16;
+
+	for (size_t begin = next.fetch_add(CHUNK, std::memory_order_relaxed); begin < running.size(); begin = next.fetch_add(CHUNK, std::memory_order_relaxed)) {
+		size_t end = std::min(begin + CHUNK, running.size());
+		for (size_t i = begin; i < end; ++i) {
+			running[i]->EmulateFrame();
+		}
+	}
+}
+
+void Scheduler::Work() {
+	uint64_t done = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stopping || generation != done; });
+			if (stopping) {
+				return;
+			}
+			done = generation;
+		}
+
+		EmulateRunning();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy == 0) {
+			finished.notify_one();
+		}
+	}
+}
+
+size_t Scheduler::Active() const {
+	size_t active = 0;
+	for (const SessionTask& task : tasks) {
+		active += !task.Done();
+	}
+	return active;
+}
+
+
+static SessionTask DriveSession(Session& session, unsigned int frames) {
+	for (unsigned int frame = 0; frame < frames; ++frame) {
+		co_await session.NextFrame();
+
+		if (session.chip8.WaitingForKey()) {
+			co_await session.KeyPress();
+		}
+	}
+}
+
+int MeasureSessions(const char* romFilename, size_t count, unsigned int frames, unsigned int threads) {
+	using Clock = std::chrono::steady_clock;
+
+	LoadResult loaded = Chip8().LoadROM(romFilename);
+	if (loaded != LoadResult::Ok) {
+		std::cerr << "Cannot load " << romFilename << ": " << LoadResultMessage(loaded) << "\n";
+		return 1;
+	}
+
+	for (unsigned int cyclesPerFrame : { 0u, 10u }) {
+		std::vector<Session> sessions;
+		sessions.reserve(count);
+
+		Scheduler scheduler(threads);
+		size_t baseBytes = SessionTask::FrameBytes();
+
+		for (size_t i = 0; i < count; ++i) {
+			sessions.emplace_back(romFilename, cyclesPerFrame);
+			scheduler.Spawn(sessions.back(), DriveSession(sessions.back(), frames));
+		}
+
+		size_t coroutineBytes = (SessionTask::FrameBytes() - baseBytes) / (count ? count : 1);
+
+		auto start = Clock::now();
+		for (unsigned int frame = 0; frame <= frames; ++frame) {
+			scheduler.RunFrame();
+
+			// sessions parked on Fx0A get key 0 held for the next frame so they keep running
+			for (Session& session : sessions) {
+				scheduler.PostKey(session, 0, false);
+				if (session.chip8.WaitingForKey()) {
+					scheduler.PostKey(session, 0, true);
+				}
+			}
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		double resumes = static_cast<double>(count) * frames;
+
+		std::cout << "cycles/frame " << cyclesPerFrame
+			<< ": sessions " << count
+			<< ", bytes/session " << sizeof(Session) + coroutineBytes
+			<< " (session " << sizeof(Session) << ", coroutine frame " << coroutineBytes << ")"
+			<< ", ns/resume " << (resumes > 0 ? seconds * 1e9 / resumes : 0.0)
+			<< "\n";
+	}
+
+	return 0;
+}
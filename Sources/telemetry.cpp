@@ -0,0 +1,63 @@
+#include "telemetry.h"
+
+#include <fstream>
+
+
+// middle of the range of values a bucket holds
+uint64_t LatencyHistogram::BucketValue(unsigned int bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+
+	unsigned int shift = bucket / SUB_BUCKETS - 1;
+	uint64_t low = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+
+	return low + ((1ull << shift) >> 1);
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const {
+	if (!count) {
+		return 0;
+	}
+
+	uint64_t target = static_cast<uint64_t>(fraction * count + 0.5);
+	if (target < 1) {
+		target = 1;
+	}
+
+	uint64_t seen = 0;
+	for (unsigned int bucket = 0; bucket < BUCKETS; ++bucket) {
+		seen += buckets[bucket];
+		if (seen >= target) {
+			uint64_t value = BucketValue(bucket);
+			return value < max ? value : max;
+		}
+	}
+
+	return max;
+}
+
+bool FrameTelemetry::WriteCsv(const char* filename) const {
+	static const char* const names[PHASE_COUNT] = { "emulate", "upload", "present" };
+
+	std::ofstream file(filename);
+
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << "phase,count,p50_us,p99_us,p999_us,max_us\n";
+
+	for (unsigned int phase = 0; phase < PHASE_COUNT; ++phase) {
+		const LatencyHistogram& histogram = histograms[phase];
+
+		file << names[phase] << ","
+			<< histogram.Count() << ","
+			<< histogram.Percentile(0.5) / 1000.0 << ","
+			<< histogram.Percentile(0.99) / 1000.0 << ","
+			<< histogram.Percentile(0.999) / 1000.0 << ","
+			<< histogram.Max() / 1000.0 << "\n";
+	}
+
+	return true;
+}
@@ -0,0 +1,157 @@
+#include "timeline.h"
+
+#include <algorithm>
+
+
+Timeline::Timeline(uint64_t interval, size_t capacity) : interval(interval ? interval : 1), capacity(capacity ? capacity : 1) {}
+
+void Timeline::Start(const Chip8& chip8) {
+	position = 0;
+	checkpoints.clear();
+	inputs.clear();
+	NoteInput(chip8);
+	AddCheckpoint(chip8);
+}
+
+void Timeline::Truncate() {
+	while (!checkpoints.empty() && checkpoints.back().cycle > position) {
+		checkpoints.pop_back();
+	}
+	while (!inputs.empty() && inputs.back().cycle > position) {
+		inputs.pop_back();
+	}
+}
+
+void Timeline::NoteInput(const Chip8& chip8) {
+	if (!inputs.empty() && inputs.back().keypad == chip8.keypad) {
+		return;
+	}
+
+	if (inputs.empty() || inputs.back().cycle != position) {
+		inputs.push_back({ position, 0 });
+	}
+	inputs.back().keypad = chip8.keypad;
+}
+
+void Timeline::AddCheckpoint(const Chip8& chip8) {
+	checkpoints.emplace_back();
+	checkpoints.back().cycle = position;
+	chip8.SaveState(checkpoints.back().state);
+
+	if (checkpoints.size() > capacity) {
+		checkpoints.pop_front();
+
+		// keep the last input before the oldest checkpoint, it still applies there
+		uint64_t oldest = checkpoints.front().cycle;
+		auto first = std::upper_bound(inputs.begin(), inputs.end(), oldest,
+			[](uint64_t cycle, const InputEvent& input) { return cycle < input.cycle; });
+		if (first - inputs.begin() > 1) {
+			inputs.erase(inputs.begin(), first - 1);
+		}
+	}
+}
+
+StopReason Timeline::Run(Chip8& chip8, Debugger& debugger, uint64_t cycles, bool resume) {
+	Truncate();
+	NoteInput(chip8);
+
+	uint64_t end = position + cycles;
+	while (position < end) {
+		if (position % interval == 0 && (checkpoints.empty() || checkpoints.back().cycle != position)) {
+			AddCheckpoint(chip8);
+		}
+
+		// stop at the next checkpoint boundary
+		uint64_t chunk = std::min(end - position, interval - position % interval);
+		uint64_t executed = debugger.Executed();
+		StopReason reason = debugger.Run(chip8, chunk, resume);
+		position += debugger.Executed() - executed;
+		resume = false;
+
+		if (reason != StopReason::Step) {
+			return reason;
+		}
+	}
+
+	return StopReason::Step;
+}
+
+uint64_t Timeline::Replay(Chip8& chip8, size_t checkpoint, uint64_t target, const Debugger* breakpoints) {
+	const Checkpoint& from = checkpoints[checkpoint];
+	chip8.LoadState(from.state);
+
+	// the input before the checkpoint holds the keypad at it
+	auto next = std::upper_bound(inputs.begin(), inputs.end(), from.cycle,
+		[](uint64_t cycle, const InputEvent& input) { return cycle < input.cycle; });
+	if (next != inputs.begin()) {
+		chip8.keypad = (next - 1)->keypad;
+	}
+
+	uint64_t lastHit = UINT64_MAX;
+	uint64_t cycle = from.cycle;
+	while (cycle < target) {
+		uint64_t until = next != inputs.end() ? std::min(target, next->cycle) : target;
+
+		if (breakpoints) {
+			for (; cycle < until; ++cycle) {
+				if (breakpoints->Breakpoint(chip8.ProgramCounter())) {
+					lastHit = cycle;
+				}
+				chip8.Cycle();
+			}
+		}
+		else {
+			for (; cycle < until; ++cycle) {
+				chip8.Cycle();
+			}
+		}
+
+		if (next != inputs.end() && next->cycle == cycle) {
+			chip8.keypad = next->keypad;
+			++next;
+		}
+	}
+
+	return lastHit;
+}
+
+bool Timeline::ReverseStep(Chip8& chip8, uint64_t count) {
+	if (checkpoints.empty()) {
+		return count == 0;
+	}
+
+	bool reached = count <= position - Oldest();
+	uint64_t target = reached ? position - count : Oldest();
+
+	auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), target,
+		[](uint64_t cycle, const Checkpoint& checkpoint) { return cycle < checkpoint.cycle; });
+	Replay(chip8, static_cast<size_t>(after - checkpoints.begin()) - 1, target, nullptr);
+	position = target;
+
+	return reached;
+}
+
+StopReason Timeline::ReverseContinue(Chip8& chip8, const Debugger& debugger) {
+	if (checkpoints.empty()) {
+		return StopReason::Limit;
+	}
+
+	// search backwards one checkpoint interval at a time, the latest hit in an interval wins
+	uint64_t end = position;
+	auto before = std::lower_bound(checkpoints.begin(), checkpoints.end(), end,
+		[](const Checkpoint& checkpoint, uint64_t cycle) { return checkpoint.cycle < cycle; });
+
+	for (size_t k = static_cast<size_t>(before - checkpoints.begin()); k-- > 0;) {
+		uint64_t hit = Replay(chip8, k, end, &debugger);
+		if (hit != UINT64_MAX) {
+			Replay(chip8, k, hit, nullptr);
+			position = hit;
+			return StopReason::Breakpoint;
+		}
+		end = checkpoints[k].cycle;
+	}
+
+	Replay(chip8, 0, Oldest(), nullptr);
+	position = Oldest();
+	return StopReason::Limit;
+}
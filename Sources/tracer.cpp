@@ -0,0 +1,137 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "disassembler.h"
+
+
+Tracer::Tracer(const char* filename, size_t ringRecords) : filename(filename) {
+	// ring size is rounded up to a power of two so positions wrap with a mask
+	size_t size = 1;
+	while (size < ringRecords) {
+		size <<= 1;
+	}
+
+	ring.resize(size);
+	mask = size - 1;
+
+	Grow(size);
+	thread = std::thread(&Tracer::Spill, this);
+}
+
+Tracer::~Tracer() {
+	stop.store(true, std::memory_order_release);
+	thread.join();
+
+	// trim the file to the records actually written and fill in the header
+	file.OpenWrite(filename, sizeof(TraceFileHeader) + written * sizeof(TraceRecord));
+
+	if (file.Data()) {
+		TraceFileHeader header{};
+		memcpy(header.magic, "C8TR", 4);
+		header.recordSize = sizeof(TraceRecord);
+		header.count = written;
+		header.dropped = dropped.load(std::memory_order_relaxed);
+		header.flags = flags;
+		memcpy(file.Data(), &header, sizeof(header));
+	}
+
+	file.Close();
+}
+
+// make room in the file for at least this many records
+bool Tracer::Grow(uint64_t records) {
+	size_t capacity = file.Size() > sizeof(TraceFileHeader) ? (file.Size() - sizeof(TraceFileHeader)) / sizeof(TraceRecord) : 0;
+
+	if (records <= capacity) {
+		return true;
+	}
+
+	while (capacity < records) {
+		capacity = capacity ? capacity * 2 : ring.size();
+	}
+
+	return file.OpenWrite(filename, sizeof(TraceFileHeader) + capacity * sizeof(TraceRecord));
+}
+
+void Tracer::Spill() {
+	for (;;) {
+		bool stopping = stop.load(std::memory_order_acquire);
+		uint64_t end = head.load(std::memory_order_acquire);
+		uint64_t start = tail.load(std::memory_order_relaxed);
+
+		if (start == end) {
+			if (stopping) {
+				return;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		if (!Grow(written + (end - start))) {
+			// out of disk, keep draining so the core is not stalled
+			dropped.fetch_add(end - start, std::memory_order_relaxed);
+			tail.store(end, std::memory_order_release);
+			continue;
+		}
+
+		// copy in up to two pieces, the ring may wrap
+		TraceRecord* out = reinterpret_cast<TraceRecord*>(file.Data() + sizeof(TraceFileHeader)) + written;
+		while (start != end) {
+			size_t first = start & mask;
+			size_t count = static_cast<size_t>(std::min<uint64_t>(end - start, ring.size() - first));
+
+			memcpy(out, &ring[first], count * sizeof(TraceRecord));
+			out += count;
+			start += count;
+			written += count;
+
+			tail.store(start, std::memory_order_release);
+		}
+	}
+}
+
+
+int DecodeTrace(const char* filename, std::ostream& out) {
+	MappedFile file;
+
+	if (!file.OpenRead(filename) || file.Size() < sizeof(TraceFileHeader)) {
+		out << "cannot read trace " << filename << "\n";
+		return 1;
+	}
+
+	TraceFileHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+
+	if (memcmp(header.magic, "C8TR", 4) != 0 || header.recordSize != sizeof(TraceRecord)
+		|| file.Size() < sizeof(header) + header.count * sizeof(TraceRecord)) {
+		out << "not a trace file: " << filename << "\n";
+		return 1;
+	}
+
+	const TraceRecord* records = reinterpret_cast<const TraceRecord*>(file.Data() + sizeof(header));
+	bool xo = (header.flags & TRACE_XO) != 0;
+
+	for (uint64_t i = 0; i < header.count; ++i) {
+		const TraceRecord& record = records[i];
+		char line[192];
+
+		int length = snprintf(line, sizeof(line), "%12llu  %03X  %04X  %-20s I=%03X",
+			static_cast<unsigned long long>(record.cycle), record.pc, record.opcode, Disassemble(record.opcode, xo).c_str(), record.index);
+
+		for (unsigned int reg = 0; reg < 16 && length > 0; ++reg) {
+			if (record.writes & (1u << reg)) {
+				length += snprintf(line + length, sizeof(line) - length, "  V%X=%02X", reg, record.registers[reg]);
+			}
+		}
+
+		out << line << "\n";
+	}
+
+	out << header.count << " records, " << header.dropped << " dropped\n";
+	return 0;
+}